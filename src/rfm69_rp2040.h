@@ -24,6 +24,8 @@
 // Must be included first
 #include "rfm69_rp2040_interface.h"
 
+#include "rfm69_rp2040_config.h"
 #include "rfm69_rp2040_rudp.h"
+#include "rfm69_rp2040_wtp.h"
 
 #endif // RFM69_PICO_H
@@ -0,0 +1,130 @@
+// rfm69_rp2040_afc.c
+// Automatic frequency correction and per peer carrier offsets
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "rfm69_rp2040_interface.h"
+#include "rfm69_rp2040_config.h"
+
+bool rfm69_afc_auto_set(rfm69_context_t *rfm, bool enabled) {
+	uint8_t bits = RFM69_AFC_FEI_AFC_AUTO_ON | RFM69_AFC_FEI_AFC_AUTOCLEAR;
+
+	return rfm69_write_masked(rfm, RFM69_REG_AFC_FEI, enabled ? bits : 0x00, bits);
+}
+
+bool rfm69_afc_bw_set(rfm69_context_t *rfm, RFM69_RXBW_MANTISSA mantissa, uint8_t exponent) {
+	// Same layout as RegRxBw, keep DccFreq as is
+	return rfm69_write_masked(
+			rfm,
+			RFM69_REG_AFCBW,
+			(mantissa & RFM69_RXBW_MANTISSA_MASK) | (exponent & RFM69_RXBW_EXPONENT_MASK),
+			RFM69_RXBW_MANTISSA_MASK | RFM69_RXBW_EXPONENT_MASK
+	);
+}
+
+bool rfm69_afc_offset_set(rfm69_context_t *rfm, int32_t hz) {
+	if (hz == rfm->afc_offset) {
+		rfm->return_status = RFM69_OK;
+		return true;
+	}
+
+	uint8_t buf[3];
+	if (!rfm69_read(rfm, RFM69_REG_FRF_MSB, buf, 3)) return false;
+
+	uint32_t frf = (uint32_t) buf[0] << 16 | (uint32_t) buf[1] << 8 | buf[2];
+	frf += RFM69_FRF_STEPS_FROM_HZ(hz) - RFM69_FRF_STEPS_FROM_HZ(rfm->afc_offset);
+
+	if (!_frf_write(rfm, frf)) return false;
+	rfm->afc_offset = hz;
+
+	return true;
+}
+
+int32_t rfm69_afc_measure(const struct rfm69_packet_meta_s *meta) {
+	// FEI measures what is left after the AFC correction
+	return meta->afc_hz + (meta->fei_valid ? meta->fei_hz : 0);
+}
+
+void rfm69_afc_table_init(rfm69_afc_table_t *table) {
+	table->count = 0;
+	table->next = 0;
+}
+
+static int _afc_find(const rfm69_afc_table_t *table, uint8_t address) {
+	for (int i = 0; i < table->count; i++)
+		if (table->address[i] == address) return i;
+	return -1;
+}
+
+void rfm69_afc_learn(
+		rfm69_afc_table_t *table,
+		uint8_t address,
+		int32_t applied_hz,
+		int32_t measured_hz)
+{
+	int32_t target = applied_hz + measured_hz;
+
+	int i = _afc_find(table, address);
+	if (i >= 0) {
+		table->offset_hz[i] += (target - table->offset_hz[i]) / 2;
+		return;
+	}
+
+	if (table->count < RFM69_AFC_PEERS_MAX) {
+		i = table->count++;
+	} else {
+		i = table->next;
+		table->next = (table->next + 1) % RFM69_AFC_PEERS_MAX;
+	}
+
+	table->address[i] = address;
+	table->offset_hz[i] = target;
+}
+
+bool rfm69_afc_peer_get(const rfm69_afc_table_t *table, uint8_t address, int32_t *hz) {
+	int i = _afc_find(table, address);
+	if (i < 0) return false;
+
+	*hz = table->offset_hz[i];
+	return true;
+}
+
+bool rfm69_afc_peer_apply(rfm69_context_t *rfm, const rfm69_afc_table_t *table, uint8_t address) {
+	int32_t hz = 0;
+	rfm69_afc_peer_get(table, address, &hz);
+
+	return rfm69_afc_offset_set(rfm, hz);
+}
+
+bool _frf_write(rfm69_context_t *rfm, uint32_t frf) {
+	uint8_t buf[3] = {
+		(frf >> 16) & 0xFF,
+		(frf >> 8) & 0xFF,
+		frf & 0xFF
+	};
+
+	// The synthesizer retunes once RegFrfLsb is written
+	if (!rfm69_write(rfm, RFM69_REG_FRF_MSB, buf, 3)) return false;
+
+	// Drop anything picked up on the old frequency
+	if (rfm->op_mode == RFM69_OP_MODE_RX)
+		return rfm69_write_masked(rfm, RFM69_REG_PACKET_CONFIG_2, 0x04, 0x04);
+
+	rfm->return_status = RFM69_OK;
+	return true;
+}
@@ -0,0 +1,243 @@
+// rfm69_rp2040_config.c
+// Declarative radio configuration applied with a minimal number of SPI bursts
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "rfm69_rp2040_config.h"
+#include "string.h"
+
+void rfm69_reg_image_clear(rfm69_reg_image_t *image) {
+	memset(image, 0x00, sizeof *image);
+}
+
+bool rfm69_reg_image_set(
+		rfm69_reg_image_t *image,
+		uint8_t address,
+		uint8_t value,
+		uint8_t mask
+)
+{
+	if (address == RFM69_REG_FIFO || address >= RFM69_SHADOW_SIZE) return false;
+
+	image->value[address] &= ~mask;
+	image->value[address] |= value & mask;
+	image->mask[address] |= mask;
+
+	return true;
+}
+
+// Finds the end (inclusive) of the burst starting at <start>, bridging
+// short untouched gaps whose contents are known from the shadow.
+static uint8_t _burst_end(
+		rfm69_context_t *rfm,
+		const rfm69_reg_image_t *image,
+		uint8_t start
+)
+{
+	uint8_t end = start;
+	uint8_t value;
+
+	for (uint8_t next = start + 1; next < RFM69_SHADOW_SIZE; next++) {
+		if (image->mask[next]) {
+			end = next;
+			continue;
+		}
+
+		// Untouched register. Look ahead for the next touched one.
+		uint8_t gap_end = next;
+		while (gap_end < RFM69_SHADOW_SIZE && !image->mask[gap_end]) gap_end++;
+
+		if (gap_end >= RFM69_SHADOW_SIZE) break;
+		if (gap_end - next > RFM69_BURST_GAP_MAX) break;
+
+		bool known = true;
+		for (uint8_t g = next; g < gap_end; g++)
+			if (!rfm69_shadow_get(rfm, g, &value)) known = false;
+		if (!known) break;
+
+		end = gap_end;
+		next = gap_end;
+	}
+
+	return end;
+}
+
+bool rfm69_reg_image_apply(rfm69_context_t *rfm, const rfm69_reg_image_t *image) {
+	uint8_t buf[RFM69_SHADOW_SIZE];
+	uint8_t base[RFM69_SHADOW_SIZE];
+
+	// The image sets the carrier outright
+	if (image->mask[RFM69_REG_FRF_LSB]) rfm->afc_offset = 0;
+
+	uint8_t address = RFM69_REG_OP_MODE;
+	while (address < RFM69_SHADOW_SIZE) {
+		if (!image->mask[address]) {
+			address++;
+			continue;
+		}
+
+		uint8_t start = address;
+		uint8_t end = _burst_end(rfm, image, start);
+		uint8_t len = end - start + 1;
+
+		// Gather current values for anything not fully owned by the image.
+		// Bridged gaps are always known, so a miss here means a register
+		// we have never seen.
+		bool known = true;
+		bool need_read = false;
+		for (uint8_t i = 0; i < len; i++) {
+			if (rfm69_shadow_get(rfm, start + i, &base[i])) continue;
+
+			known = false;
+			if (image->mask[start + i] != 0xFF) need_read = true;
+		}
+
+		if (need_read) {
+			if (!rfm69_read(rfm, start, base, len)) return false;
+			known = true;
+		}
+
+		bool unchanged = known;
+		for (uint8_t i = 0; i < len; i++) {
+			uint8_t mask = image->mask[start + i];
+			buf[i] = (base[i] & ~mask) | (image->value[start + i] & mask);
+			if (buf[i] != base[i]) unchanged = false;
+		}
+
+		if (!unchanged && !rfm69_write(rfm, start, buf, len)) return false;
+
+		address = end + 1;
+	}
+
+	rfm->return_status = RFM69_OK;
+	return true;
+}
+
+bool rfm69_config_compile(
+		const struct rfm69_radio_config_s *config,
+		rfm69_reg_image_t *image
+)
+{
+	uint32_t fields = config->fields;
+
+	if (fields & RFM69_CONFIG_FREQUENCY) {
+		uint32_t frf = RFM69_FRF_FROM_HZ(config->frequency);
+		rfm69_reg_image_set(image, RFM69_REG_FRF_MSB, (frf >> 16) & 0xFF, 0xFF);
+		rfm69_reg_image_set(image, RFM69_REG_FRF_MID, (frf >> 8) & 0xFF, 0xFF);
+		rfm69_reg_image_set(image, RFM69_REG_FRF_LSB, frf & 0xFF, 0xFF);
+	}
+
+	if (fields & RFM69_CONFIG_BITRATE) {
+		rfm69_reg_image_set(image, RFM69_REG_BITRATE_MSB, (config->bitrate >> 8) & 0xFF, 0xFF);
+		rfm69_reg_image_set(image, RFN69_REG_BITRATE_LSB, config->bitrate & 0xFF, 0xFF);
+	}
+
+	if (fields & RFM69_CONFIG_FDEV) {
+		uint32_t fdev = RFM69_FDEV_FROM_HZ(config->fdev);
+		if (fdev > 0x3FFF) return false;
+
+		rfm69_reg_image_set(image, RFM69_REG_FDEV_MSB, (fdev >> 8) & 0x3F, 0xFF);
+		rfm69_reg_image_set(image, RFM69_REG_FDEV_LSB, fdev & 0xFF, 0xFF);
+	}
+
+	if (fields & RFM69_CONFIG_RXBW) {
+		rfm69_reg_image_set(
+				image,
+				RFM69_REG_RXBW,
+				config->rxbw_mantissa | (config->rxbw_exponent & RFM69_RXBW_EXPONENT_MASK),
+				RFM69_RXBW_MANTISSA_MASK | RFM69_RXBW_EXPONENT_MASK
+		);
+	}
+
+	if (fields & RFM69_CONFIG_DATA_MODE)
+		rfm69_reg_image_set(image, RFM69_REG_DATA_MODUL, config->data_mode, RFM69_DATA_MODE_MASK);
+
+	if (fields & RFM69_CONFIG_MODULATION_TYPE)
+		rfm69_reg_image_set(image, RFM69_REG_DATA_MODUL, config->modulation_type, RFM69_MODULATION_TYPE_MASK);
+
+	if (fields & RFM69_CONFIG_MODULATION_SHAPING)
+		rfm69_reg_image_set(image, RFM69_REG_DATA_MODUL, config->modulation_shaping, RFM69_MODULATION_SHAPING_MASK);
+
+	if (fields & RFM69_CONFIG_RSSI_THRESHOLD)
+		rfm69_reg_image_set(image, RFM69_REG_RSSI_THRESH, config->rssi_threshold, 0xFF);
+
+	if (fields & RFM69_CONFIG_SYNC) {
+		if (config->sync_size < 1 || config->sync_size > 8) return false;
+
+		rfm69_reg_image_set(
+				image,
+				RFM69_REG_SYNC_CONFIG,
+				(config->sync_size - 1) << _SYNC_SIZE_OFFSET,
+				_SYNC_SIZE_MASK
+		);
+		for (uint8_t i = 0; i < config->sync_size; i++)
+			rfm69_reg_image_set(image, RFM69_REG_SYNC_VALUE_1 + i, config->sync_value[i], 0xFF);
+	}
+
+	if (fields & RFM69_CONFIG_PACKET_FORMAT)
+		rfm69_reg_image_set(image, RFM69_REG_PACKET_CONFIG_1, config->packet_format, 0x80);
+
+	if (fields & RFM69_CONFIG_DCFREE)
+		rfm69_reg_image_set(image, RFM69_REG_PACKET_CONFIG_1, config->dcfree, _DCFREE_SETTING_MASK);
+
+	// CrcAutoClearOff, so the bit is inverted
+	if (fields & RFM69_CONFIG_CRC_AUTOCLEAR)
+		rfm69_reg_image_set(image, RFM69_REG_PACKET_CONFIG_1, !config->crc_autoclear << 3, 0x08);
+
+	if (fields & RFM69_CONFIG_ADDRESS_FILTER)
+		rfm69_reg_image_set(image, RFM69_REG_PACKET_CONFIG_1, config->address_filter, _ADDRESS_FILTER_MASK);
+
+	if (fields & RFM69_CONFIG_PAYLOAD_LENGTH)
+		rfm69_reg_image_set(image, RFM69_REG_PAYLOAD_LENGTH, config->payload_length, 0xFF);
+
+	if (fields & RFM69_CONFIG_NODE_ADDRESS)
+		rfm69_reg_image_set(image, RFM69_REG_NODE_ADRS, config->node_address, 0xFF);
+
+	if (fields & RFM69_CONFIG_BROADCAST_ADDRESS)
+		rfm69_reg_image_set(image, RFM69_REG_BROADCAST_ADRS, config->broadcast_address, 0xFF);
+
+	if (fields & RFM69_CONFIG_TX_START_CONDITION)
+		rfm69_reg_image_set(image, RFM69_REG_FIFO_THRESH, config->tx_start_condition, _TX_START_CONDITION_MASK);
+
+	if (fields & RFM69_CONFIG_DAGC)
+		rfm69_reg_image_set(image, RFM69_REG_TEST_DAGC, config->dagc, 0xFF);
+
+	return true;
+}
+
+bool rfm69_config_apply(
+		rfm69_context_t *rfm,
+		const struct rfm69_radio_config_s *config
+)
+{
+	rfm69_reg_image_t image;
+	rfm69_reg_image_clear(&image);
+
+	if (!rfm69_config_compile(config, &image)) {
+		rfm->return_status = RFM69_INVALID_CONFIG;
+		return false;
+	}
+
+	if (!rfm69_reg_image_apply(rfm, &image)) return false;
+
+	// Keep cached context state in line with the radio
+	if (config->fields & RFM69_CONFIG_NODE_ADDRESS)
+		rfm->address = config->node_address;
+
+	return true;
+}
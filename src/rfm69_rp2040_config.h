@@ -0,0 +1,148 @@
+// rfm69_rp2040_config.h
+// Declarative radio configuration applied with a minimal number of SPI bursts
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef RFM69_RP2040_CONFIG_H
+#define RFM69_RP2040_CONFIG_H
+
+#include "rfm69_rp2040_interface.h"
+
+// Register value conversions. These are what rfm69_frequency_set and
+// rfm69_fdev_set use, so both paths put the same bytes on the radio.
+// Fstep is FXOSC / 2^19 (61.035 Hz), rounded to the nearest step.
+#define RFM69_FRF_FROM_HZ(hz) \
+	((uint32_t)((((uint64_t)(hz) << 19) + RFM69_FXOSC / 2) / RFM69_FXOSC))
+#define RFM69_FDEV_FROM_HZ(hz) RFM69_FRF_FROM_HZ(hz)
+
+// Register value -> Hz, rounded
+#define RFM69_HZ_FROM_FRF(frf) \
+	((uint32_t)(((uint64_t)(frf) * RFM69_FXOSC + (1u << 18)) >> 19))
+
+// The same for signed offsets (AFC, FEI), rounded away from zero so
+// +x and -x land the same distance from the carrier
+#define RFM69_FRF_STEPS_FROM_HZ(hz) \
+	((hz) < 0 ? -(int32_t) RFM69_FRF_FROM_HZ(-(int64_t)(hz)) : (int32_t) RFM69_FRF_FROM_HZ(hz))
+#define RFM69_HZ_FROM_FRF_STEPS(steps) \
+	((steps) < 0 ? -(int32_t) RFM69_HZ_FROM_FRF(-(int64_t)(steps)) : (int32_t) RFM69_HZ_FROM_FRF(steps))
+
+// Untouched registers between two runs are bridged into a single burst
+// if their values are known from the shadow and the gap is at most
+// this many registers. A new transaction costs a CS cycle plus an
+// address byte, so bridging a couple of bytes is always cheaper.
+#ifndef RFM69_BURST_GAP_MAX
+#define RFM69_BURST_GAP_MAX 2
+#endif
+
+// Register image: the compiled form of a radio configuration.
+// mask holds the bits of each register owned by the image. A mask of 0
+// leaves the register untouched, 0xFF replaces it entirely, anything in
+// between is a read-modify-write of that field.
+typedef struct rfm69_reg_image {
+	uint8_t value[RFM69_SHADOW_SIZE];
+	uint8_t mask[RFM69_SHADOW_SIZE];
+} rfm69_reg_image_t;
+
+// Selects which members of rfm69_radio_config_s are applied.
+typedef enum _CONFIG_FIELD {
+	RFM69_CONFIG_FREQUENCY          = 0x00001,
+	RFM69_CONFIG_BITRATE            = 0x00002,
+	RFM69_CONFIG_FDEV               = 0x00004,
+	RFM69_CONFIG_RXBW               = 0x00008,
+	RFM69_CONFIG_DATA_MODE          = 0x00010,
+	RFM69_CONFIG_MODULATION_TYPE    = 0x00020,
+	RFM69_CONFIG_MODULATION_SHAPING = 0x00040,
+	RFM69_CONFIG_RSSI_THRESHOLD     = 0x00080,
+	RFM69_CONFIG_SYNC               = 0x00100,
+	RFM69_CONFIG_PACKET_FORMAT      = 0x00200,
+	RFM69_CONFIG_DCFREE             = 0x00400,
+	RFM69_CONFIG_CRC_AUTOCLEAR      = 0x00800,
+	RFM69_CONFIG_ADDRESS_FILTER     = 0x01000,
+	RFM69_CONFIG_PAYLOAD_LENGTH     = 0x02000,
+	RFM69_CONFIG_NODE_ADDRESS       = 0x04000,
+	RFM69_CONFIG_BROADCAST_ADDRESS  = 0x08000,
+	RFM69_CONFIG_TX_START_CONDITION = 0x10000,
+	RFM69_CONFIG_DAGC               = 0x20000,
+} RFM69_CONFIG_FIELD;
+
+// Declarative radio configuration. Only members whose RFM69_CONFIG_*
+// bit is set in <fields> are applied; everything else on the radio is
+// left alone. This makes it usable both for a full boot configuration
+// and for switching between partial profiles.
+struct rfm69_radio_config_s {
+	uint32_t fields;                      // OR of RFM69_CONFIG_FIELD
+
+	uint32_t frequency;                   // Hz
+	RFM69_MODEM_BITRATE bitrate;
+	uint32_t fdev;                        // Hz
+	RFM69_RXBW_MANTISSA rxbw_mantissa;
+	uint8_t rxbw_exponent;
+
+	RFM69_DATA_MODE data_mode;
+	RFM69_MODULATION_TYPE modulation_type;
+	RFM69_MODULATION_SHAPING modulation_shaping;
+
+	uint8_t rssi_threshold;
+	uint8_t sync_size;                    // 1 -> 8 bytes
+	uint8_t sync_value[8];
+
+	RFM69_PACKET_FORMAT packet_format;
+	RFM69_DCFREE_SETTING dcfree;
+	bool crc_autoclear;
+	RFM69_ADDRESS_FILTER address_filter;
+	uint8_t payload_length;
+	uint8_t node_address;
+	uint8_t broadcast_address;
+	RFM69_TX_START_CONDITION tx_start_condition;
+	RFM69_DAGC_SETTING dagc;
+};
+
+// Empties a register image.
+void rfm69_reg_image_clear(rfm69_reg_image_t *image);
+
+// Merges <value> into register <address> of the image under <mask>.
+// Returns false for the FIFO or addresses outside the register map.
+bool rfm69_reg_image_set(
+		rfm69_reg_image_t *image,
+		uint8_t address,
+		uint8_t value,
+		uint8_t mask
+);
+
+// Writes a register image to the radio.
+// Touched registers are grouped into contiguous bursts (bridging short
+// gaps the shadow knows about). Runs containing partially masked fields
+// without a shadow entry cost one extra burst read. Runs whose result
+// matches the shadow are skipped entirely.
+bool rfm69_reg_image_apply(rfm69_context_t *rfm, const rfm69_reg_image_t *image);
+
+// Compiles <config> into <image>. Fields not selected are left as they
+// are in <image>, so several configs can be merged into one image.
+// Returns false if the config is invalid.
+bool rfm69_config_compile(
+		const struct rfm69_radio_config_s *config,
+		rfm69_reg_image_t *image
+);
+
+// Compiles and applies <config> in one call.
+bool rfm69_config_apply(
+		rfm69_context_t *rfm,
+		const struct rfm69_radio_config_s *config
+);
+
+#endif // RFM69_RP2040_CONFIG_H
@@ -0,0 +1,267 @@
+// rfm69_rp2040_cont.c
+// Continuous mode bitstreams clocked by PIO and moved by DMA
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "rfm69_rp2040_interface.h"
+#include "rfm69_rp2040_cont_ring.h"
+#include "rfm69_rp2040_cont.pio.h"
+#include "hardware/dma.h"
+
+// RX capture runs until stopped, this is days at 300 kbps
+#define _CONT_RX_WORDS 0xFFFFFFFF
+
+// Both programs are shared by every state machine on a PIO block
+static uint _rx_offset[NUM_PIOS];
+static uint _tx_offset[NUM_PIOS];
+static uint _programs_loaded = 0; // Bit n set once loaded on PIO n
+
+bool rfm69_cont_init(
+		rfm69_cont_t *cont,
+		rfm69_context_t *rfm,
+		const struct rfm69_cont_config_s *config)
+{
+	PIO pio = config->pio ? config->pio : pio0;
+	uint pio_index = pio_get_index(pio);
+
+	if (!(_programs_loaded & (1u << pio_index))) {
+		if (!pio_can_add_program(pio, &rfm69_cont_rx_program)) return false;
+		_rx_offset[pio_index] = pio_add_program(pio, &rfm69_cont_rx_program);
+
+		if (!pio_can_add_program(pio, &rfm69_cont_tx_program)) return false;
+		_tx_offset[pio_index] = pio_add_program(pio, &rfm69_cont_tx_program);
+
+		_programs_loaded |= 1u << pio_index;
+	}
+
+	int sm = pio_claim_unused_sm(pio, false);
+	if (sm < 0) return false;
+
+	int chan = dma_claim_unused_channel(false);
+	if (chan < 0) {
+		pio_sm_unclaim(pio, sm);
+		return false;
+	}
+
+	cont->rfm = rfm;
+	cont->pio = pio;
+	cont->sm = sm;
+	cont->dma_chan = chan;
+	cont->pin_dclk = config->pin_dclk;
+	cont->pin_data = config->pin_data;
+	cont->ring = NULL;
+	cont->ring_bits = 0;
+	cont->tail = 0;
+	cont->overruns = 0;
+
+	// Both stay inputs until TX needs DATA
+	pio_gpio_init(pio, config->pin_dclk);
+	pio_gpio_init(pio, config->pin_data);
+	pio_sm_set_pindirs_with_mask(
+			pio,
+			sm,
+			0,
+			(1u << config->pin_dclk) | (1u << config->pin_data)
+	);
+
+	return true;
+}
+
+// Radio side of both directions: continuous mode with the bit
+// synchronizer, DCLK on DIO1 and DATA on DIO2.
+static bool _cont_radio_setup(rfm69_context_t *rfm) {
+	if (!rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY)) return false;
+
+	// DCLK would raise a FifoLevel event on every bit
+	_events_dio_suspend(rfm, 1, true);
+	if (!rfm69_data_mode_set(rfm, RFM69_DATA_MODE_CONTINUOUS_BIT_SYNC)) return false;
+
+	return rfm69_write_masked(
+			rfm,
+			RFM69_REG_DIO_MAPPING_1,
+			RFM69_DIO1_CONT_DCLK | RFM69_DIO2_CONT_DATA,
+			RFM69_DIO_1_MASK | RFM69_DIO_2_MASK
+	);
+}
+
+static void _cont_sm_start(rfm69_cont_t *cont, uint offset, pio_sm_config *c) {
+	PIO pio = cont->pio;
+	uint sm = cont->sm;
+
+	sm_config_set_jmp_pin(c, cont->pin_dclk);
+	sm_config_set_clkdiv_int_frac(c, 1, 0);
+
+	pio_sm_set_enabled(pio, sm, false);
+	pio_sm_init(pio, sm, offset, c);
+	pio_sm_set_enabled(pio, sm, true);
+}
+
+bool rfm69_cont_rx_start(rfm69_cont_t *cont, void *ring, uint ring_bits) {
+	rfm69_context_t *rfm = cont->rfm;
+
+	// DMA ring limits, and the ring has to be naturally aligned
+	if (ring_bits < 3 || ring_bits > 15
+			|| ((uintptr_t) ring & ((1u << ring_bits) - 1))) {
+		rfm->return_status = RFM69_INVALID_CONFIG;
+		return false;
+	}
+
+	if (!_cont_radio_setup(rfm)) return false;
+
+	cont->ring = ring;
+	cont->ring_bits = ring_bits;
+	cont->tail = 0;
+	cont->overruns = 0;
+
+	PIO pio = cont->pio;
+	uint sm = cont->sm;
+	uint offset = _rx_offset[pio_get_index(pio)];
+
+	pio_sm_config c = rfm69_cont_rx_program_get_default_config(offset);
+	sm_config_set_in_pins(&c, cont->pin_data);
+	// MSB first, autopush every 32 bits
+	sm_config_set_in_shift(&c, false, true, 32);
+	sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+
+	pio_sm_set_pindirs_with_mask(pio, sm, 0, 1u << cont->pin_data);
+
+	// Words come out first bit in bit 31. Swapping bytes keeps the ring
+	// in the order the bits arrived.
+	dma_channel_config dc = dma_channel_get_default_config(cont->dma_chan);
+	channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+	channel_config_set_dreq(&dc, pio_get_dreq(pio, sm, false));
+	channel_config_set_read_increment(&dc, false);
+	channel_config_set_write_increment(&dc, true);
+	channel_config_set_ring(&dc, true, ring_bits);
+	channel_config_set_bswap(&dc, true);
+	dma_channel_configure(
+			cont->dma_chan,
+			&dc,
+			ring,
+			&pio->rxf[sm],
+			_CONT_RX_WORDS,
+			true
+	);
+
+	_cont_sm_start(cont, offset, &c);
+
+	return rfm69_mode_set(rfm, RFM69_OP_MODE_RX);
+}
+
+// Bytes the DMA has written since rfm69_cont_rx_start
+static uint64_t _cont_head(rfm69_cont_t *cont) {
+	uint32_t remaining = dma_channel_hw_addr(cont->dma_chan)->transfer_count;
+	return _cont_ring_head(_CONT_RX_WORDS, remaining);
+}
+
+size_t rfm69_cont_available(rfm69_cont_t *cont) {
+	if (cont->ring == NULL) return 0;
+
+	return _cont_ring_available(_cont_head(cont), cont->tail, cont->ring_bits);
+}
+
+size_t rfm69_cont_read(rfm69_cont_t *cont, void *dst, size_t size) {
+	if (cont->ring == NULL) return 0;
+
+	return _cont_ring_read(
+			cont->ring,
+			cont->ring_bits,
+			_cont_head(cont),
+			&cont->tail,
+			&cont->overruns,
+			dst,
+			size
+	);
+}
+
+bool rfm69_cont_tx_start(rfm69_cont_t *cont, const void *src, size_t len) {
+	rfm69_context_t *rfm = cont->rfm;
+
+	if (len == 0 || len % 4) {
+		rfm->return_status = RFM69_INVALID_CONFIG;
+		return false;
+	}
+
+	if (!_cont_radio_setup(rfm)) return false;
+	cont->ring = NULL;
+
+	PIO pio = cont->pio;
+	uint sm = cont->sm;
+	uint offset = _tx_offset[pio_get_index(pio)];
+
+	pio_sm_config c = rfm69_cont_tx_program_get_default_config(offset);
+	sm_config_set_out_pins(&c, cont->pin_data, 1);
+	// MSB first, autopull every 32 bits
+	sm_config_set_out_shift(&c, false, true, 32);
+	sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+
+	pio_sm_set_pins_with_mask(pio, sm, 0, 1u << cont->pin_data);
+	pio_sm_set_pindirs_with_mask(pio, sm, 1u << cont->pin_data, 1u << cont->pin_data);
+
+	_cont_sm_start(cont, offset, &c);
+
+	// rfm69_cont_tx_busy waits for the program to stall on an empty FIFO
+	pio->fdebug = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm);
+
+	// Byte swapped so the first byte of <src> is shifted out first
+	dma_channel_config dc = dma_channel_get_default_config(cont->dma_chan);
+	channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+	channel_config_set_dreq(&dc, pio_get_dreq(pio, sm, true));
+	channel_config_set_read_increment(&dc, true);
+	channel_config_set_write_increment(&dc, false);
+	channel_config_set_bswap(&dc, true);
+	dma_channel_configure(
+			cont->dma_chan,
+			&dc,
+			&pio->txf[sm],
+			src,
+			len / 4,
+			true
+	);
+
+	return rfm69_mode_set(rfm, RFM69_OP_MODE_TX);
+}
+
+bool rfm69_cont_tx_busy(rfm69_cont_t *cont) {
+	if (dma_channel_is_busy(cont->dma_chan)) return true;
+	if (!pio_sm_is_tx_fifo_empty(cont->pio, cont->sm)) return true;
+
+	// Set once the out after the last bit found nothing to pull
+	return !(cont->pio->fdebug & (1u << (PIO_FDEBUG_TXSTALL_LSB + cont->sm)));
+}
+
+bool rfm69_cont_stop(rfm69_cont_t *cont) {
+	PIO pio = cont->pio;
+	uint sm = cont->sm;
+
+	pio_sm_set_enabled(pio, sm, false);
+	dma_channel_abort(cont->dma_chan);
+	pio_sm_clear_fifos(pio, sm);
+	pio_sm_restart(pio, sm);
+
+	// Release DATA back to the radio
+	pio_sm_set_pindirs_with_mask(pio, sm, 0, 1u << cont->pin_data);
+	cont->ring = NULL;
+
+	if (!rfm69_mode_set(cont->rfm, RFM69_OP_MODE_STDBY)) return false;
+	if (!rfm69_data_mode_set(cont->rfm, RFM69_DATA_MODE_PACKET)) return false;
+
+	// Same DIO1 mapping as FifoLevel, so only the IRQ has to come back
+	_events_dio_suspend(cont->rfm, 1, false);
+	return true;
+}
@@ -0,0 +1,69 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// ------------- //
+// rfm69_cont_rx //
+// ------------- //
+
+#define rfm69_cont_rx_wrap_target 0
+#define rfm69_cont_rx_wrap 3
+
+static const uint16_t rfm69_cont_rx_program_instructions[] = {
+            //     .wrap_target
+    0x00c0, //  0: jmp    pin, 0                     
+    0x00c3, //  1: jmp    pin, 3                     
+    0x0001, //  2: jmp    1                          
+    0x4001, //  3: in     pins, 1                    
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program rfm69_cont_rx_program = {
+    .instructions = rfm69_cont_rx_program_instructions,
+    .length = 4,
+    .origin = -1,
+};
+
+static inline pio_sm_config rfm69_cont_rx_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + rfm69_cont_rx_wrap_target, offset + rfm69_cont_rx_wrap);
+    return c;
+}
+#endif
+
+// ------------- //
+// rfm69_cont_tx //
+// ------------- //
+
+#define rfm69_cont_tx_wrap_target 0
+#define rfm69_cont_tx_wrap 3
+
+static const uint16_t rfm69_cont_tx_program_instructions[] = {
+            //     .wrap_target
+    0x00c2, //  0: jmp    pin, 2                     
+    0x0000, //  1: jmp    0                          
+    0x00c2, //  2: jmp    pin, 2                     
+    0x6001, //  3: out    pins, 1                    
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program rfm69_cont_tx_program = {
+    .instructions = rfm69_cont_tx_program_instructions,
+    .length = 4,
+    .origin = -1,
+};
+
+static inline pio_sm_config rfm69_cont_tx_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + rfm69_cont_tx_wrap_target, offset + rfm69_cont_tx_wrap);
+    return c;
+}
+#endif
@@ -0,0 +1,83 @@
+// rfm69_rp2040_cont_ring.h
+// Ring arithmetic of the continuous mode RX capture
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef RFM69_RP2040_CONT_RING_H
+#define RFM69_RP2040_CONT_RING_H
+
+// Nothing here touches the hardware, so the host tests build it as is.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Bytes the DMA has written once <remaining> of its <words> 32 bit
+// transfers are left.
+static inline uint64_t _cont_ring_head(uint32_t words, uint32_t remaining) {
+	return (uint64_t) (words - remaining) * 4;
+}
+
+// Bytes between <tail> and <head>, at most a whole ring.
+static inline size_t _cont_ring_available(uint64_t head, uint64_t tail, unsigned ring_bits) {
+	uint64_t available = head - tail;
+	uint32_t size = 1u << ring_bits;
+
+	return available > size ? size : available;
+}
+
+// Copies up to <size> bytes from <tail> on out of <ring> into <dst> and
+// moves <tail> past them. <head> is where the DMA is.
+static inline size_t _cont_ring_read(
+		const uint8_t *ring,
+		unsigned ring_bits,
+		uint64_t head,
+		uint64_t *tail,
+		uint32_t *overruns,
+		void *dst,
+		size_t size)
+{
+	uint32_t ring_size = 1u << ring_bits;
+	uint32_t ring_mask = ring_size - 1;
+
+	// The DMA has lapped us. Skip to the newer half, which it is not
+	// about to overwrite.
+	if (head - *tail > ring_size) {
+		*tail = head - ring_size / 2;
+		(*overruns)++;
+	}
+
+	size_t len = head - *tail;
+	if (len > size) len = size;
+
+	uint8_t *out = dst;
+	size_t copied = 0;
+	while (copied < len) {
+		uint32_t start = (*tail + copied) & ring_mask;
+		size_t chunk = ring_size - start;
+		if (chunk > len - copied) chunk = len - copied;
+
+		memcpy(out + copied, ring + start, chunk);
+		copied += chunk;
+	}
+
+	*tail += len;
+	return len;
+}
+
+#endif // RFM69_RP2040_CONT_RING_H
@@ -132,6 +132,7 @@
 
 #define RFM69_FIFO_SIZE             66 // The FIFO size is fixed to 66 bytes 
 #define RFM69_FSTEP                 61
+#define RFM69_FXOSC           32000000 // Crystal oscillator Hz
 
 
 typedef enum _RETURN {
@@ -139,8 +140,20 @@ typedef enum _RETURN {
     RFM69_REGISTER_TEST_FAIL      = -2,
     RFM69_SPI_UNEXPECTED_RETURN   = -3,
     RFM69_RSSI_BUSY               = -5,
+    RFM69_DMA_UNAVAILABLE         = -6,
+    RFM69_INVALID_CONFIG          = -7,
+    RFM69_TIMEOUT                 = -8,
+    RFM69_PIO_UNAVAILABLE         = -9,
+    RFM69_PACKET_OVERFLOW         = -10,
+    RFM69_FIFO_OVERRUN            = -11,
 } RFM69_RETURN;
 
+// Bus backend used to talk to the radio
+typedef enum _TRANSPORT {
+    RFM69_TRANSPORT_SPI = 0, // Hardware SPI block, CS driven by the CPU
+    RFM69_TRANSPORT_PIO,     // PIO state machine, CS sequenced in hardware
+} RFM69_TRANSPORT;
+
 #define _OP_MODE_OFFSET 2
 typedef enum _OP_MODE {
     RFM69_OP_MODE_DEFAULT = 0x01,
@@ -152,6 +165,72 @@ typedef enum _OP_MODE {
     RFM69_OP_MODE_MASK    = 0x07 << _OP_MODE_OFFSET
 } RFM69_OP_MODE;
 
+// RegOpMode Listen Mode bits
+#define RFM69_OP_MODE_LISTEN_ON    0x40
+#define RFM69_OP_MODE_LISTEN_ABORT 0x20
+
+#define _LISTEN_RESOL_IDLE_OFFSET 6
+#define _LISTEN_RESOL_RX_OFFSET   4
+typedef enum _LISTEN_RESOL {
+    RFM69_LISTEN_RESOL_64_US  = 0x01,
+    RFM69_LISTEN_RESOL_4_1_MS = 0x02,
+    RFM69_LISTEN_RESOL_262_MS = 0x03,
+} RFM69_LISTEN_RESOL;
+
+typedef enum _LISTEN_CRITERIA {
+    RFM69_LISTEN_CRITERIA_RSSI      = 0x00, // RSSI above threshold
+    RFM69_LISTEN_CRITERIA_RSSI_SYNC = 0x08, // RSSI and SyncAddress match
+} RFM69_LISTEN_CRITERIA;
+
+typedef enum _LISTEN_END {
+    RFM69_LISTEN_END_RX     = 0x00 << 1, // Stay in RX until PayloadReady/Timeout
+    RFM69_LISTEN_END_MODE   = 0x01 << 1, // Then go to Mode, Listen Mode stops
+    RFM69_LISTEN_END_RESUME = 0x02 << 1, // Then resume Listen Mode idle
+} RFM69_LISTEN_END;
+
+// RegAfcFei
+typedef enum _AFC_FEI {
+    RFM69_AFC_FEI_AFC_START      = 0x01,
+    RFM69_AFC_FEI_AFC_CLEAR      = 0x02,
+    RFM69_AFC_FEI_AFC_AUTO_ON    = 0x04,
+    RFM69_AFC_FEI_AFC_AUTOCLEAR  = 0x08,
+    RFM69_AFC_FEI_AFC_DONE       = 0x10,
+    RFM69_AFC_FEI_FEI_START      = 0x20,
+    RFM69_AFC_FEI_FEI_DONE       = 0x40,
+} RFM69_AFC_FEI;
+
+// RegAutoModes
+#define _AUTO_ENTER_OFFSET 5
+typedef enum _AUTO_ENTER {
+    RFM69_AUTO_ENTER_OFF            = 0x00 << _AUTO_ENTER_OFFSET,
+    RFM69_AUTO_ENTER_FIFO_NOT_EMPTY = 0x01 << _AUTO_ENTER_OFFSET, // Rising edge
+    RFM69_AUTO_ENTER_FIFO_LEVEL     = 0x02 << _AUTO_ENTER_OFFSET,
+    RFM69_AUTO_ENTER_CRC_OK         = 0x03 << _AUTO_ENTER_OFFSET,
+    RFM69_AUTO_ENTER_PAYLOAD_READY  = 0x04 << _AUTO_ENTER_OFFSET,
+    RFM69_AUTO_ENTER_SYNC_ADDRESS   = 0x05 << _AUTO_ENTER_OFFSET,
+    RFM69_AUTO_ENTER_PACKET_SENT    = 0x06 << _AUTO_ENTER_OFFSET,
+    RFM69_AUTO_ENTER_FIFO_EMPTY     = 0x07 << _AUTO_ENTER_OFFSET, // Falling FifoNotEmpty
+} RFM69_AUTO_ENTER;
+
+#define _AUTO_EXIT_OFFSET 2
+typedef enum _AUTO_EXIT {
+    RFM69_AUTO_EXIT_OFF                   = 0x00 << _AUTO_EXIT_OFFSET,
+    RFM69_AUTO_EXIT_FIFO_EMPTY            = 0x01 << _AUTO_EXIT_OFFSET, // Falling FifoNotEmpty
+    RFM69_AUTO_EXIT_FIFO_LEVEL_TIMEOUT    = 0x02 << _AUTO_EXIT_OFFSET, // Rising edge or Timeout
+    RFM69_AUTO_EXIT_CRC_OK_TIMEOUT        = 0x03 << _AUTO_EXIT_OFFSET,
+    RFM69_AUTO_EXIT_PAYLOAD_READY_TIMEOUT = 0x04 << _AUTO_EXIT_OFFSET,
+    RFM69_AUTO_EXIT_SYNC_ADDRESS_TIMEOUT  = 0x05 << _AUTO_EXIT_OFFSET,
+    RFM69_AUTO_EXIT_PACKET_SENT           = 0x06 << _AUTO_EXIT_OFFSET,
+    RFM69_AUTO_EXIT_TIMEOUT               = 0x07 << _AUTO_EXIT_OFFSET,
+} RFM69_AUTO_EXIT;
+
+typedef enum _AUTO_INTERMEDIATE {
+    RFM69_AUTO_INTERMEDIATE_SLEEP = 0x00,
+    RFM69_AUTO_INTERMEDIATE_STDBY = 0x01,
+    RFM69_AUTO_INTERMEDIATE_RX    = 0x02,
+    RFM69_AUTO_INTERMEDIATE_TX    = 0x03,
+} RFM69_AUTO_INTERMEDIATE;
+
 #define _DATA_MODE_OFFSET 5
 typedef enum _DATA_MODE {
     RFM69_DATA_MODE_PACKET,
@@ -224,6 +303,17 @@ typedef enum _IRQ_2_FLAG {
     RFM69_IRQ2_FLAG_FIFO_FULL      = 0x80
 } RFM69_IRQ2_FLAG;
 
+// Radio events latched from DIO interrupts (or polled from the IRQ flag
+// registers when the corresponding DIO is not wired).
+typedef enum _EVENT {
+    RFM69_EVENT_MODE_READY    = 0x01, // DIO5
+    RFM69_EVENT_PACKET_SENT   = 0x02, // DIO0 in TX
+    RFM69_EVENT_PAYLOAD_READY = 0x04, // DIO0 in RX
+    RFM69_EVENT_FIFO_LEVEL    = 0x08, // DIO1, FIFO above FifoThreshold
+    RFM69_EVENT_TIMEOUT       = 0x10, // DIO4 in RX, RegRxTimeout1/2 expired
+    RFM69_EVENT_SYNC_ADDRESS  = 0x20, // DIO3 in RX, sync word (and address) matched
+} RFM69_EVENT;
+
 typedef enum _RSSI_CONFIG {
     RFM69_RSSI_MEASURMENT_START = 0x01,
     RFM69_RSSI_MEASURMENT_DONE  = 0x02
@@ -348,6 +438,8 @@ typedef enum _DIO1_CFG {
     RFM69_DIO1_PKT_RX_FIFO_FULL    = 0x01 << _DIO_1_OFFSET,
     RFM69_DIO1_PKT_RX_FIFO_N_EMPTY = 0x02 << _DIO_1_OFFSET,
     RFM69_DIO1_PKT_RX_TIMEOUT      = 0x03 << _DIO_1_OFFSET,
+	// Continuous, Tx and Rx
+    RFM69_DIO1_CONT_DCLK           = 0x00 << _DIO_1_OFFSET,
 } RFM69_DIO1_CFG;
 
 #define RFM69_DIO_2_MASK 0x0C
@@ -363,6 +455,8 @@ typedef enum _DIO2_CFG {
     RFM69_DIO2_PKT_RX_DATA         = 0x01 << _DIO_2_OFFSET,
     RFM69_DIO2_PKT_RX_UNUSED       = 0x02 << _DIO_2_OFFSET,
     RFM69_DIO2_PKT_RX_AUTO_MODE    = 0x03 << _DIO_2_OFFSET,
+	// Continuous, Tx and Rx (any mapping)
+    RFM69_DIO2_CONT_DATA           = 0x00 << _DIO_2_OFFSET,
 } RFM69_DIO2_CFG;
 
 #define RFM69_DIO_3_MASK 0x03
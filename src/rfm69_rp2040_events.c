@@ -0,0 +1,351 @@
+// rfm69_rp2040_events.c
+// GPIO interrupt driven radio events (DIO pins) with SPI polling fallback
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "rfm69_rp2040_interface.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+// Events whose DIO level stays high for as long as the condition holds.
+// For these a high pin also counts, which covers edges that happened
+// before the DIO was pointed at the event. ModeReady is high in every
+// settled mode, so only its rising edge means anything.
+#define _EVENT_LEVEL_MASK (RFM69_EVENT_PACKET_SENT \
+		| RFM69_EVENT_PAYLOAD_READY \
+		| RFM69_EVENT_FIFO_LEVEL \
+		| RFM69_EVENT_TIMEOUT \
+		| RFM69_EVENT_SYNC_ADDRESS)
+
+// GPIO -> context lookup for the raw IO bank IRQ handler
+static rfm69_context_t *_dio_contexts[NUM_BANK0_GPIOS];
+static uint8_t _dio_index[NUM_BANK0_GPIOS];
+static uint32_t _dio_irq_mask = 0; // Pins the handler is registered for
+
+static void _dio_irq_handler(void) {
+	for (uint pin = 0; pin < NUM_BANK0_GPIOS; pin++) {
+		rfm69_context_t *rfm = _dio_contexts[pin];
+		if (rfm == NULL || !(_dio_irq_mask & (1u << pin))) continue;
+		if (!(gpio_get_irq_event_mask(pin) & GPIO_IRQ_EDGE_RISE)) continue;
+
+		gpio_acknowledge_irq(pin, GPIO_IRQ_EDGE_RISE);
+		RFM69_EVENT event = rfm->dio_event[_dio_index[pin]];
+		rfm->events |= event;
+
+		if (event == RFM69_EVENT_PAYLOAD_READY) rfm->payload_ready_us = time_us_64();
+	}
+
+	// Wake a waiter that might be sleeping on the other core
+	__sev();
+}
+
+// Registers the handler as a raw handler for the pins in <mask>, so the
+// SDK's own GPIO callback handler leaves those pins alone and apps can
+// still use gpio_set_irq_enabled_with_callback for theirs.
+static void _dio_irq_mask_set(uint32_t mask) {
+	if (mask == _dio_irq_mask) return;
+
+	if (_dio_irq_mask) gpio_remove_raw_irq_handler_masked(_dio_irq_mask, _dio_irq_handler);
+	if (mask) {
+		gpio_add_raw_irq_handler_masked(mask, _dio_irq_handler);
+		irq_set_enabled(IO_IRQ_BANK0, true);
+	}
+
+	_dio_irq_mask = mask;
+}
+
+// Returns the pin carrying <event>, or RFM69_PIN_UNUSED.
+static uint _event_pin(rfm69_context_t *rfm, RFM69_EVENT event) {
+	for (uint dio = 0; dio < RFM69_DIO_NUM; dio++) {
+		if (rfm->pin_dio[dio] == RFM69_PIN_UNUSED) continue;
+		if (rfm->dio_event[dio] == event) return rfm->pin_dio[dio];
+	}
+
+	return RFM69_PIN_UNUSED;
+}
+
+// IRQ flag behind <event>
+static bool _event_flag(const rfm69_irq_flags_t *flags, RFM69_EVENT event) {
+	switch (event) {
+		case RFM69_EVENT_MODE_READY:
+			return rfm69_irq1_flag_test(flags, RFM69_IRQ1_FLAG_MODE_READY);
+		case RFM69_EVENT_PACKET_SENT:
+			return rfm69_irq2_flag_test(flags, RFM69_IRQ2_FLAG_PACKET_SENT);
+		case RFM69_EVENT_PAYLOAD_READY:
+			return rfm69_irq2_flag_test(flags, RFM69_IRQ2_FLAG_PAYLOAD_READY);
+		case RFM69_EVENT_FIFO_LEVEL:
+			return rfm69_irq2_flag_test(flags, RFM69_IRQ2_FLAG_FIFO_LEVEL);
+		case RFM69_EVENT_TIMEOUT:
+			return rfm69_irq1_flag_test(flags, RFM69_IRQ1_FLAG_TIMEOUT);
+		case RFM69_EVENT_SYNC_ADDRESS:
+			return rfm69_irq1_flag_test(flags, RFM69_IRQ1_FLAG_SYNC_ADDRESS_MATCH);
+		default:
+			return false;
+	}
+}
+
+// SPI fallback for events without a wired DIO.
+// One burst covers every event flag.
+static bool _event_poll(rfm69_context_t *rfm, RFM69_EVENT event, bool *state) {
+	rfm69_irq_flags_t flags;
+	if (!rfm69_irq_flags_get(rfm, &flags)) return false;
+
+	*state = _event_flag(&flags, event);
+
+	return true;
+}
+
+static bool _dio0_map(rfm69_context_t *rfm, RFM69_OP_MODE mode) {
+	RFM69_DIO0_CFG mapping;
+	RFM69_EVENT event;
+
+	if (mode == RFM69_OP_MODE_TX) {
+		mapping = RFM69_DIO0_PKT_TX_PACKET_SENT;
+		event = RFM69_EVENT_PACKET_SENT;
+	}
+	else {
+		mapping = RFM69_DIO0_PKT_RX_PAYLOAD_READY;
+		event = RFM69_EVENT_PAYLOAD_READY;
+	}
+
+	if (!rfm69_dio0_config_set(rfm, mapping)) return false;
+
+	// Anything latched under the old mapping no longer applies
+	uint32_t irq_state = save_and_disable_interrupts();
+	rfm->events &= ~rfm->dio_event[0];
+	rfm->dio_event[0] = event;
+	restore_interrupts(irq_state);
+
+	return true;
+}
+
+void _events_reset(rfm69_context_t *rfm) {
+	uint32_t mask = _dio_irq_mask;
+	for (uint pin = 0; pin < NUM_BANK0_GPIOS; pin++) {
+		if (_dio_contexts[pin] != rfm) continue;
+
+		gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE, false);
+		_dio_contexts[pin] = NULL;
+		mask &= ~(1u << pin);
+	}
+	_dio_irq_mask_set(mask);
+
+	for (uint dio = 0; dio < RFM69_DIO_NUM; dio++) {
+		rfm->pin_dio[dio] = RFM69_PIN_UNUSED;
+		rfm->dio_event[dio] = 0;
+	}
+	rfm->events = 0;
+}
+
+bool rfm69_dio_pin_set(rfm69_context_t *rfm, uint dio, uint pin) {
+	if (dio >= RFM69_DIO_NUM || (pin != RFM69_PIN_UNUSED && pin >= NUM_BANK0_GPIOS)) {
+		rfm->return_status = RFM69_INVALID_CONFIG;
+		return false;
+	}
+
+	uint old_pin = rfm->pin_dio[dio];
+	if (old_pin != RFM69_PIN_UNUSED) {
+		gpio_set_irq_enabled(old_pin, GPIO_IRQ_EDGE_RISE, false);
+		_dio_contexts[old_pin] = NULL;
+		_dio_irq_mask_set(_dio_irq_mask & ~(1u << old_pin));
+	}
+
+	rfm->pin_dio[dio] = RFM69_PIN_UNUSED;
+	rfm->dio_event[dio] = 0;
+
+	if (pin == RFM69_PIN_UNUSED) {
+		rfm->return_status = RFM69_OK;
+		return true;
+	}
+
+	switch (dio) {
+		case 0:
+			if (!_dio0_map(rfm, rfm->op_mode)) return false;
+			break;
+		case 1:
+			// Same mapping in TX and RX
+			if (!rfm69_dio1_config_set(rfm, RFM69_DIO1_PKT_TX_FIFO_LVL)) return false;
+			rfm->dio_event[1] = RFM69_EVENT_FIFO_LEVEL;
+			break;
+		case 3:
+			// Unused (low) in TX
+			if (!rfm69_dio3_config_set(rfm, RFM69_DIO3_PKT_RX_SYNC_ADDRESS)) return false;
+			rfm->dio_event[3] = RFM69_EVENT_SYNC_ADDRESS;
+			break;
+		case 4:
+			// ModeReady in TX, the pin only means Timeout in RX
+			if (!rfm69_dio4_config_set(rfm, RFM69_DIO4_PKT_RX_TIMEOUT)) return false;
+			rfm->dio_event[4] = RFM69_EVENT_TIMEOUT;
+			break;
+		case 5:
+			if (!rfm69_dio5_config_set(rfm, RFM69_DIO5_PKT_RX_MODE_READY)) return false;
+			rfm->dio_event[5] = RFM69_EVENT_MODE_READY;
+			break;
+		default:
+			// No events for this DIO (yet). The pin is still recorded
+			// so its level can be read.
+			break;
+	}
+
+	gpio_init(pin);
+	gpio_set_dir(pin, GPIO_IN);
+	gpio_pull_down(pin);
+
+	rfm->pin_dio[dio] = pin;
+
+	if (rfm->dio_event[dio]) {
+		_dio_contexts[pin] = rfm;
+		_dio_index[pin] = dio;
+
+		_dio_irq_mask_set(_dio_irq_mask | 1u << pin);
+
+		gpio_acknowledge_irq(pin, GPIO_IRQ_EDGE_RISE);
+		gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE, true);
+	}
+
+	rfm->return_status = RFM69_OK;
+	return true;
+}
+
+void _events_dio_suspend(rfm69_context_t *rfm, uint dio, bool suspend) {
+	uint pin = rfm->pin_dio[dio];
+	if (pin == RFM69_PIN_UNUSED || !rfm->dio_event[dio]) return;
+
+	gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE, false);
+	gpio_acknowledge_irq(pin, GPIO_IRQ_EDGE_RISE);
+	rfm69_event_clear(rfm, rfm->dio_event[dio]);
+
+	if (!suspend) gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE, true);
+}
+
+bool _events_mode_change(rfm69_context_t *rfm, RFM69_OP_MODE mode) {
+	// DIO0 only has to follow TX <-> RX. In every other mode the
+	// previous mapping is harmless.
+	if (rfm->pin_dio[0] != RFM69_PIN_UNUSED
+			&& (mode == RFM69_OP_MODE_TX || mode == RFM69_OP_MODE_RX))
+	{
+		if (!_dio0_map(rfm, mode)) return false;
+	}
+
+	rfm69_event_clear(rfm, RFM69_EVENT_MODE_READY);
+
+	// DIO4 showed ModeReady if we come from TX, and a SyncAddress edge
+	// from an earlier RX is over
+	if (mode == RFM69_OP_MODE_RX)
+		rfm69_event_clear(rfm, RFM69_EVENT_TIMEOUT | RFM69_EVENT_SYNC_ADDRESS);
+
+	return true;
+}
+
+bool rfm69_event_check(rfm69_context_t *rfm, RFM69_EVENT event, bool *state) {
+	uint pin = _event_pin(rfm, event);
+	if (pin == RFM69_PIN_UNUSED) return _event_poll(rfm, event, state);
+
+	uint32_t irq_state = save_and_disable_interrupts();
+	*state = (rfm->events & event) != 0;
+	rfm->events &= ~event;
+	restore_interrupts(irq_state);
+
+	if (!*state && (event & _EVENT_LEVEL_MASK)) *state = gpio_get(pin);
+
+	rfm->return_status = RFM69_OK;
+	return true;
+}
+
+bool _event_level(rfm69_context_t *rfm, RFM69_EVENT event, bool *state) {
+	uint pin = _event_pin(rfm, event);
+	if (pin == RFM69_PIN_UNUSED) return _event_poll(rfm, event, state);
+
+	*state = gpio_get(pin);
+
+	rfm->return_status = RFM69_OK;
+	return true;
+}
+
+// rfm69_event_check for several events at once. Unwired events share a
+// single IRQ flag burst.
+static bool _events_check(rfm69_context_t *rfm, uint32_t events, uint32_t *occurred) {
+	uint32_t unwired = 0;
+	*occurred = 0;
+
+	for (uint32_t event = 1; event && event <= events; event <<= 1) {
+		if (!(events & event)) continue;
+
+		if (_event_pin(rfm, event) == RFM69_PIN_UNUSED) {
+			unwired |= event;
+			continue;
+		}
+
+		bool state;
+		if (!rfm69_event_check(rfm, event, &state)) return false;
+		if (state) *occurred |= event;
+	}
+
+	if (unwired) {
+		rfm69_irq_flags_t flags;
+		if (!rfm69_irq_flags_get(rfm, &flags)) return false;
+
+		for (uint32_t event = 1; event && event <= unwired; event <<= 1)
+			if ((unwired & event) && _event_flag(&flags, event)) *occurred |= event;
+	}
+
+	rfm->return_status = RFM69_OK;
+	return true;
+}
+
+bool rfm69_event_wait(rfm69_context_t *rfm, RFM69_EVENT event, uint32_t timeout_us) {
+	uint32_t occurred;
+	return rfm69_event_wait_any(rfm, event, timeout_us, &occurred);
+}
+
+bool rfm69_event_wait_any(
+		rfm69_context_t *rfm,
+		uint32_t events,
+		uint32_t timeout_us,
+		uint32_t *occurred)
+{
+	// Only sleep if every event can wake us
+	bool wired = true;
+	for (uint32_t event = 1; event && event <= events; event <<= 1)
+		if ((events & event) && _event_pin(rfm, event) == RFM69_PIN_UNUSED) wired = false;
+
+	absolute_time_t timeout_time = make_timeout_time_us(timeout_us);
+
+	for (;;) {
+		if (!_events_check(rfm, events, occurred)) return false;
+		if (*occurred) return true;
+
+		if (timeout_us == 0) {
+			if (wired) __wfe();
+			continue;
+		}
+
+		if (time_reached(timeout_time)) break;
+		if (wired) best_effort_wfe_or_timeout(timeout_time);
+	}
+
+	rfm->return_status = RFM69_TIMEOUT;
+	return false;
+}
+
+void rfm69_event_clear(rfm69_context_t *rfm, uint32_t events) {
+	uint32_t irq_state = save_and_disable_interrupts();
+	rfm->events &= ~events;
+	restore_interrupts(irq_state);
+}
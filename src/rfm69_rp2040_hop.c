@@ -0,0 +1,98 @@
+// rfm69_rp2040_hop.c
+// Frequency hopping over precomputed FRF channel tables
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "rfm69_rp2040_interface.h"
+#include "rfm69_rp2040_config.h"
+
+static uint _gcd(uint a, uint b) {
+	while (b) {
+		uint t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+bool rfm69_channel_plan_init(
+		rfm69_channel_plan_t *plan,
+		uint32_t base_hz,
+		uint32_t spacing_hz,
+		uint channels)
+{
+	if (channels == 0 || channels > RFM69_HOP_CHANNELS_MAX) return false;
+
+	plan->channels = channels;
+	plan->step = 1;
+	plan->offset = 0;
+	plan->current = 0;
+	plan->prelock = false;
+
+	for (uint i = 0; i < channels; i++)
+		rfm69_channel_plan_set(plan, i, base_hz + spacing_hz * i);
+
+	return true;
+}
+
+bool rfm69_channel_plan_set(rfm69_channel_plan_t *plan, uint channel, uint32_t hz) {
+	if (channel >= plan->channels) return false;
+
+	// Same conversion as rfm69_frequency_set, exact to the nearest Fstep
+	uint32_t frf = RFM69_FRF_FROM_HZ(hz);
+
+	plan->frf[channel][0] = (frf >> 16) & 0xFF;
+	plan->frf[channel][1] = (frf >> 8) & 0xFF;
+	plan->frf[channel][2] = frf & 0xFF;
+
+	return true;
+}
+
+void rfm69_channel_plan_seed(rfm69_channel_plan_t *plan, uint32_t seed) {
+	uint channels = plan->channels;
+
+	plan->offset = seed % channels;
+
+	// Any step coprime with the channel count walks every channel once.
+	// A step of 1 only for single channel plans.
+	uint step = channels > 2 ? 2 + (seed >> 8) % (channels - 2) : 1;
+	while (_gcd(step, channels) != 1) step++;
+
+	plan->step = step % channels ? step : 1;
+}
+
+bool rfm69_channel_set(rfm69_context_t *rfm, rfm69_channel_plan_t *plan, uint channel) {
+	if (channel >= plan->channels) {
+		rfm->return_status = RFM69_INVALID_CONFIG;
+		return false;
+	}
+
+	uint32_t frf = (uint32_t) plan->frf[channel][0] << 16
+		| (uint32_t) plan->frf[channel][1] << 8
+		| plan->frf[channel][2];
+	frf += RFM69_FRF_STEPS_FROM_HZ(rfm->afc_offset);
+
+	if (!_frf_write(rfm, frf)) return false;
+	plan->current = channel;
+
+	bool idle = rfm->op_mode == RFM69_OP_MODE_SLEEP || rfm->op_mode == RFM69_OP_MODE_STDBY;
+	if (plan->prelock && idle) return rfm69_mode_set(rfm, RFM69_OP_MODE_FS);
+
+	rfm->return_status = RFM69_OK;
+	return true;
+}
@@ -19,7 +19,18 @@
 //	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "rfm69_rp2040_interface.h"
+#include "rfm69_rp2040_config.h"
 #include "stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "string.h"
+
+static bool _fifo_dma_init(rfm69_context_t *rfm);
+static inline uint32_t _stats_now(void);
+static void _stats_record(rfm69_context_t *rfm, uint8_t address, size_t len, uint32_t start);
+static inline bool _shadow_load(rfm69_context_t *rfm, uint8_t address, uint8_t *value);
+static void _shadow_store(rfm69_context_t *rfm, uint8_t address, const uint8_t *src, size_t len);
 
 // DEPRECATED
 //rfm69_context_t *rfm69_create() {
@@ -45,6 +56,38 @@ bool rfm69_init(
 	rfm->pa_mode = RFM69_PA_MODE_PA0;
 	rfm->ocp_trim = RFM69_OCP_TRIM_DEFAULT;
 	rfm->address = 0;
+	rfm->transport = config->transport;
+	rfm->pio = NULL;
+	rfm->pio_sm = 0;
+	rfm->dma_tx_chan = -1;
+	rfm->dma_rx_chan = -1;
+	rfm->fifo_busy = false;
+	rfm->fifo_callback = NULL;
+	rfm->fifo_callback_data = NULL;
+	rfm->fifo_overruns = 0;
+	rfm->fei_started = false;
+	rfm->payload_ready_us = 0;
+	rfm->afc_offset = 0;
+	rfm->aes_enabled = false;
+	rfm->aes_key_valid = false;
+	rfm->listening = false;
+	rfm->auto_modes = 0;
+	rfm->shadow_enabled = config->reg_shadow;
+	rfm69_shadow_invalidate(rfm);
+	rfm69_stats_reset(rfm);
+	_events_reset(rfm);
+
+	if (rfm->transport == RFM69_TRANSPORT_PIO && !_pio_spi_init(rfm, config)) {
+		rfm->return_status = RFM69_PIO_UNAVAILABLE;
+		goto RETURN;
+	}
+
+	// The PIO transport is fed by DMA, so it always wants the channels
+	bool dma = config->fifo_dma || rfm->transport == RFM69_TRANSPORT_PIO;
+	if (dma && !_fifo_dma_init(rfm)) {
+		rfm->return_status = RFM69_DMA_UNAVAILABLE;
+		goto RETURN;
+	}
 
     // Per documentation we leave RST pin floating for at least
     // 10 ms on startup. No harm in waiting 10ms here to
@@ -67,21 +110,29 @@ bool rfm69_init(
 		goto RETURN;
 	}
 
-	rfm69_data_mode_set(rfm, RFM69_DATA_MODE_PACKET);
-
 	rfm69_power_level_set(rfm, 13);
-	rfm69_rssi_threshold_set(rfm, 0xE4);
-	rfm69_tx_start_condition_set(rfm, RFM69_TX_FIFO_NOT_EMPTY);
-	rfm69_broadcast_address_set(rfm, 0xFF); 
-	rfm69_address_filter_set(rfm, RFM69_FILTER_NODE_BROADCAST);
 
-	// You have no idea how important this is and how odd
-	// the radio can behave with it off
-	rfm69_dagc_set(rfm, RFM69_DAGC_IMPROVED_0);
-
-	//Set sync value (essentially functions as subnet)
-	uint8_t sync[3] = {0x01, 0x01, 0x01};
-	rfm69_sync_value_set(rfm, sync, 3);
+	struct rfm69_radio_config_s radio_config = {
+		.fields = RFM69_CONFIG_DATA_MODE
+			| RFM69_CONFIG_RSSI_THRESHOLD
+			| RFM69_CONFIG_TX_START_CONDITION
+			| RFM69_CONFIG_BROADCAST_ADDRESS
+			| RFM69_CONFIG_ADDRESS_FILTER
+			| RFM69_CONFIG_DAGC
+			| RFM69_CONFIG_SYNC,
+		.data_mode = RFM69_DATA_MODE_PACKET,
+		.rssi_threshold = 0xE4,
+		.tx_start_condition = RFM69_TX_FIFO_NOT_EMPTY,
+		.broadcast_address = 0xFF,
+		.address_filter = RFM69_FILTER_NODE_BROADCAST,
+		// You have no idea how important this is and how odd
+		// the radio can behave with it off
+		.dagc = RFM69_DAGC_IMPROVED_0,
+		//Set sync value (essentially functions as subnet)
+		.sync_size = 3,
+		.sync_value = {0x01, 0x01, 0x01},
+	};
+	if (!rfm69_config_apply(rfm, &radio_config)) goto RETURN;
 
 	success = true;
 RETURN:
@@ -94,6 +145,13 @@ void rfm69_reset(rfm69_context_t *rfm) {
     sleep_us(100);
     gpio_put(rfm->pin_rst, 0);
     sleep_ms(5);
+
+	// Every register is back at its reset value
+	rfm69_shadow_invalidate(rfm);
+	rfm->aes_enabled = false;
+	rfm->aes_key_valid = false;
+	rfm->listening = false;
+	rfm->auto_modes = 0;
 }
 
 // 3x NOP delay added before and after spi CS pin level change
@@ -116,18 +174,41 @@ bool rfm69_write(
         const uint8_t *src,
         size_t len)
 {
+    rfm69_fifo_wait(rfm);
+    uint32_t start = _stats_now();
+
+    // Large FIFO fills go out over DMA. We still block here, but the core
+    // sleeps instead of spinning on the SPI status register.
+    if (address == RFM69_REG_FIFO 
+            && rfm->dma_tx_chan >= 0 
+            && len >= RFM69_FIFO_DMA_MIN_LEN) 
+    {
+        if (!rfm69_fifo_write_async(rfm, src, len, NULL, NULL)) return false;
+        rfm69_fifo_wait(rfm);
+        return true;
+    }
+
     address |= 0x80; // Set rw bit
-    cs_select(rfm->pin_cs); 
 
-    int rval = spi_write_blocking(rfm->spi, &address, 1);
-    rval += spi_write_blocking(rfm->spi, src, len);
+    if (rfm->transport == RFM69_TRANSPORT_PIO) {
+        _pio_spi_transfer(rfm, address, src, NULL, len);
+    }
+    else {
+        cs_select(rfm->pin_cs); 
 
-    cs_deselect(rfm->pin_cs);
+        int rval = spi_write_blocking(rfm->spi, &address, 1);
+        rval += spi_write_blocking(rfm->spi, src, len);
 
-    if (rval != len + 1) {
-        rfm->return_status = RFM69_SPI_UNEXPECTED_RETURN;
-		return false;
-	}
+        cs_deselect(rfm->pin_cs);
+
+        if (rval != len + 1) {
+            rfm->return_status = RFM69_SPI_UNEXPECTED_RETURN;
+            return false;
+        }
+    }
+
+	_stats_record(rfm, address, len, start);
+	_shadow_store(rfm, address & 0x7F, src, len);
 
 	rfm->return_status = RFM69_OK;
     return true;
@@ -140,11 +221,23 @@ bool rfm69_write_masked(
         const uint8_t mask)
 {
     uint8_t reg;
-	if (!rfm69_read(rfm, address, &reg, 1)) return false;
+	bool cached = _shadow_load(rfm, address, &reg);
+	if (!cached && !rfm69_read(rfm, address, &reg, 1)) return false;
 
+	uint8_t current = reg;
     reg &= ~mask;
     reg |= src & mask;
 
+	// The shadow is authoritative for everything except OpMode, which
+	// the sequencer (listen mode, auto modes) can change on its own.
+	if (cached && reg == current && address != RFM69_REG_OP_MODE) {
+#ifdef RFM69_STATS
+		rfm->stats.writes_skipped++;
+#endif
+		rfm->return_status = RFM69_OK;
+		return true;
+	}
+
     return rfm69_write(rfm, address, &reg, 1);
 }
 
@@ -154,19 +247,39 @@ bool rfm69_read(
         uint8_t *dst,
         size_t len)
 {
+    rfm69_fifo_wait(rfm);
+    uint32_t start = _stats_now();
+
+    if (address == RFM69_REG_FIFO 
+            && rfm->dma_rx_chan >= 0 
+            && len >= RFM69_FIFO_DMA_MIN_LEN) 
+    {
+        if (!rfm69_fifo_read_async(rfm, dst, len, NULL, NULL)) return false;
+        rfm69_fifo_wait(rfm);
+        return true;
+    }
+
     address &= 0x7F; // Clear rw bit
 
-    cs_select(rfm->pin_cs);
+    if (rfm->transport == RFM69_TRANSPORT_PIO) {
+        _pio_spi_transfer(rfm, address, NULL, dst, len);
+    }
+    else {
+        cs_select(rfm->pin_cs);
 
-    int rval = spi_write_blocking(rfm->spi, &address, 1);
-    rval += spi_read_blocking(rfm->spi, 0, dst, len);
+        int rval = spi_write_blocking(rfm->spi, &address, 1);
+        rval += spi_read_blocking(rfm->spi, 0, dst, len);
 
-    cs_deselect(rfm->pin_cs);
+        cs_deselect(rfm->pin_cs);
 
-    if (rval != len + 1) {
-        rfm->return_status = RFM69_SPI_UNEXPECTED_RETURN;
-		return false;
-	}
+        if (rval != len + 1) {
+            rfm->return_status = RFM69_SPI_UNEXPECTED_RETURN;
+            return false;
+        }
+    }
+
+	_stats_record(rfm, address, len, start);
+	_shadow_store(rfm, address, dst, len);
 
 	rfm->return_status = RFM69_OK;
 	return true;
@@ -185,6 +298,318 @@ bool rfm69_read_masked(
     return true;
 }
 
+// REGISTER SHADOW
+
+// Status registers the radio updates on its own. These are never cached.
+static inline bool _shadow_reg_volatile(uint8_t address) {
+	switch (address) {
+		case RFM69_REG_FIFO:
+		case RFM69_REG_OSC_1:
+		case RFM69_REG_VERSION:
+		case RFM69_REG_AFC_FEI:
+		case RFM69_REG_AFC_MSB:
+		case RFM69_REG_AFC_LSB:
+		case RFM69_REG_FEI_MSB:
+		case RFM69_REG_FEI_LSB:
+		case RFM69_REG_RSSI_CONFIG:
+		case RFM69_REG_RSSI_VALUE:
+		case RFM69_REG_IRQ_FLAGS_1:
+		case RFM69_REG_IRQ_FLAGS_2:
+		case RFM69_REG_TEMP_1:
+		case RFM69_REG_TEMP_2:
+			return true;
+		default:
+			return address >= RFM69_SHADOW_SIZE;
+	}
+}
+
+// Write-only trigger bits that always read back as 0
+static inline uint8_t _shadow_strobe_mask(uint8_t address) {
+	switch (address) {
+		case RFM69_REG_OP_MODE:         return 0x20; // ListenAbort
+		case RFM69_REG_PACKET_CONFIG_2: return 0x04; // RestartRx
+		default:                        return 0x00;
+	}
+}
+
+static inline bool _shadow_load(rfm69_context_t *rfm, uint8_t address, uint8_t *value) {
+	if (!rfm->shadow_enabled || _shadow_reg_volatile(address)) return false;
+	if (!(rfm->shadow_valid[address / 8] & (1 << (address % 8)))) return false;
+
+	*value = rfm->shadow[address];
+	return true;
+}
+
+// Records <len> bytes starting at <address> after a successful transfer.
+// Burst accesses auto-increment the address, except on the FIFO.
+static void _shadow_store(rfm69_context_t *rfm, uint8_t address, const uint8_t *src, size_t len) {
+	if (!rfm->shadow_enabled || address == RFM69_REG_FIFO) return;
+
+	for (size_t i = 0; i < len; i++, address++) {
+		if (_shadow_reg_volatile(address)) continue;
+
+		rfm->shadow[address] = src[i] & ~_shadow_strobe_mask(address);
+		rfm->shadow_valid[address / 8] |= 1 << (address % 8);
+	}
+}
+
+void rfm69_shadow_enable(rfm69_context_t *rfm, bool enable) {
+	rfm->shadow_enabled = enable;
+	rfm69_shadow_invalidate(rfm);
+}
+
+void rfm69_shadow_invalidate(rfm69_context_t *rfm) {
+	memset(rfm->shadow_valid, 0x00, sizeof rfm->shadow_valid);
+}
+
+bool rfm69_shadow_sync(rfm69_context_t *rfm) {
+	rfm69_shadow_invalidate(rfm);
+
+	// Everything but the FIFO in one burst. rfm69_read populates the shadow.
+	uint8_t buf[RFM69_SHADOW_SIZE - 1];
+	return rfm69_read(rfm, RFM69_REG_OP_MODE, buf, sizeof buf);
+}
+
+bool rfm69_shadow_get(rfm69_context_t *rfm, uint8_t address, uint8_t *value) {
+	return _shadow_load(rfm, address, value);
+}
+
+// STATS
+
+static inline uint32_t _stats_now(void) {
+#ifdef RFM69_STATS
+	return time_us_32();
+#else
+	return 0;
+#endif
+}
+
+// <address> carries the rw bit of the transaction
+static void _stats_record(rfm69_context_t *rfm, uint8_t address, size_t len, uint32_t start) {
+#ifdef RFM69_STATS
+	uint8_t reg = address & 0x7F;
+	if (reg >= RFM69_SHADOW_SIZE) return;
+
+	rfm69_reg_stats_t *stats = (address & 0x80) ? &rfm->stats.write[reg] : &rfm->stats.read[reg];
+	stats->count++;
+	stats->bytes += len;
+	stats->us += time_us_32() - start;
+#else
+	(void) rfm;
+	(void) address;
+	(void) len;
+	(void) start;
+#endif
+}
+
+void rfm69_stats_reset(rfm69_context_t *rfm) {
+#ifdef RFM69_STATS
+	memset(&rfm->stats, 0x00, sizeof rfm->stats);
+#else
+	(void) rfm;
+#endif
+}
+
+void rfm69_stats_print(rfm69_context_t *rfm) {
+#ifdef RFM69_STATS
+	rfm69_stats_t *stats = &rfm->stats;
+
+	printf("rfm69 stats: mode switches %lu (%lu us), masked writes skipped %lu\n",
+			(unsigned long) stats->mode_switches,
+			(unsigned long) stats->mode_switch_us,
+			(unsigned long) stats->writes_skipped);
+	printf("reg  rw      count      bytes         us\n");
+
+	for (uint reg = 0; reg < RFM69_SHADOW_SIZE; reg++) {
+		for (uint write = 0; write < 2; write++) {
+			rfm69_reg_stats_t *s = write ? &stats->write[reg] : &stats->read[reg];
+			if (s->count == 0) continue;
+
+			printf("0x%02X %c  %10lu %10lu %10lu\n",
+					reg, write ? 'W' : 'R',
+					(unsigned long) s->count,
+					(unsigned long) s->bytes,
+					(unsigned long) s->us);
+		}
+	}
+#else
+	(void) rfm;
+#endif
+}
+
+// FIFO DMA
+//
+// Each transfer uses a TX/RX channel pair so that the RX channel finishing
+// means the last byte has actually been clocked out, not just queued in the
+// SPI FIFO. Completion is always signalled by the RX channel.
+
+// Channel -> context lookup for the shared DMA IRQ handler
+static rfm69_context_t *_dma_contexts[NUM_DMA_CHANNELS];
+static bool _dma_irq_installed = false;
+
+// Source of dummy bytes for reads, sink for discarded bytes on writes
+static const uint8_t _dma_zero = 0x00;
+static uint8_t _dma_sink;
+
+static void _fifo_dma_complete(rfm69_context_t *rfm) {
+    // The PIO state machine releases CS on its own
+    if (rfm->transport == RFM69_TRANSPORT_SPI)
+        cs_deselect(rfm->pin_cs);
+
+#ifdef RFM69_STATS
+    _stats_record(rfm, rfm->stats_dma_address, rfm->stats_dma_len, rfm->stats_dma_start);
+#endif
+
+    rfm->fifo_busy = false;
+    if (rfm->fifo_callback) 
+        rfm->fifo_callback(rfm, rfm->fifo_callback_data);
+
+    // Wake a waiter that might be sleeping on the other core
+    __sev();
+}
+
+static void _fifo_dma_irq_handler(void) {
+    for (uint ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        rfm69_context_t *rfm = _dma_contexts[ch];
+        if (rfm == NULL) continue;
+        if (!dma_irqn_get_channel_status(RFM69_DMA_IRQ_INDEX, ch)) continue;
+
+        dma_irqn_acknowledge_channel(RFM69_DMA_IRQ_INDEX, ch);
+        _fifo_dma_complete(rfm);
+    }
+}
+
+static bool _fifo_dma_init(rfm69_context_t *rfm) {
+    int tx = dma_claim_unused_channel(false);
+    if (tx < 0) return false;
+
+    int rx = dma_claim_unused_channel(false);
+    if (rx < 0) {
+        dma_channel_unclaim(tx);
+        return false;
+    }
+
+    rfm->dma_tx_chan = tx;
+    rfm->dma_rx_chan = rx;
+    _dma_contexts[rx] = rfm;
+
+    if (!_dma_irq_installed) {
+        irq_add_shared_handler(
+                DMA_IRQ_0 + RFM69_DMA_IRQ_INDEX,
+                _fifo_dma_irq_handler,
+                PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY
+        );
+        irq_set_enabled(DMA_IRQ_0 + RFM69_DMA_IRQ_INDEX, true);
+        _dma_irq_installed = true;
+    }
+    dma_irqn_set_channel_enabled(RFM69_DMA_IRQ_INDEX, rx, true);
+
+    return true;
+}
+
+// Exactly one of src/dst is non NULL.
+static bool _fifo_dma_start(
+        rfm69_context_t *rfm,
+        uint8_t address,
+        const uint8_t *src,
+        uint8_t *dst,
+        size_t len,
+        rfm69_fifo_callback_t callback,
+        void *data)
+{
+    if (rfm->dma_tx_chan < 0) {
+        rfm->return_status = RFM69_DMA_UNAVAILABLE;
+        return false;
+    }
+
+    rfm69_fifo_wait(rfm);
+
+    rfm->fifo_callback = callback;
+    rfm->fifo_callback_data = data;
+
+#ifdef RFM69_STATS
+    rfm->stats_dma_start = _stats_now();
+    rfm->stats_dma_address = address;
+    rfm->stats_dma_len = len;
+#endif
+
+    if (len == 0) {
+        if (callback) callback(rfm, data);
+		rfm->return_status = RFM69_OK;
+        return true;
+    }
+
+    if (rfm->transport == RFM69_TRANSPORT_PIO) {
+        rfm->fifo_busy = true;
+        _pio_spi_dma_start(rfm, address, src, dst, len);
+
+        rfm->return_status = RFM69_OK;
+        return true;
+    }
+
+    spi_hw_t *hw = spi_get_hw(rfm->spi);
+    uint tx = rfm->dma_tx_chan;
+    uint rx = rfm->dma_rx_chan;
+
+    dma_channel_config c = dma_channel_get_default_config(tx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, spi_get_dreq(rfm->spi, true));
+    channel_config_set_read_increment(&c, src != NULL);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_configure(tx, &c, &hw->dr, src ? src : &_dma_zero, len, false);
+
+    c = dma_channel_get_default_config(rx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, spi_get_dreq(rfm->spi, false));
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, dst != NULL);
+    dma_channel_configure(rx, &c, dst ? dst : &_dma_sink, &hw->dr, len, false);
+
+    rfm->fifo_busy = true;
+    cs_select(rfm->pin_cs);
+
+    // Address byte goes out blocking. spi_write_blocking also drains the
+    // RX FIFO so the RX channel only sees data bytes.
+    if (spi_write_blocking(rfm->spi, &address, 1) != 1) {
+        cs_deselect(rfm->pin_cs);
+        rfm->fifo_busy = false;
+        rfm->return_status = RFM69_SPI_UNEXPECTED_RETURN;
+        return false;
+    }
+
+    dma_start_channel_mask((1u << tx) | (1u << rx));
+
+	rfm->return_status = RFM69_OK;
+    return true;
+}
+
+bool rfm69_fifo_write_async(
+        rfm69_context_t *rfm,
+        const uint8_t *src,
+        size_t len,
+        rfm69_fifo_callback_t callback,
+        void *data)
+{
+    return _fifo_dma_start(rfm, RFM69_REG_FIFO | 0x80, src, NULL, len, callback, data);
+}
+
+bool rfm69_fifo_read_async(
+        rfm69_context_t *rfm,
+        uint8_t *dst,
+        size_t len,
+        rfm69_fifo_callback_t callback,
+        void *data)
+{
+    return _fifo_dma_start(rfm, RFM69_REG_FIFO & 0x7F, NULL, dst, len, callback, data);
+}
+
+bool rfm69_fifo_busy(rfm69_context_t *rfm) {
+    return rfm->fifo_busy;
+}
+
+void rfm69_fifo_wait(rfm69_context_t *rfm) {
+    while (rfm->fifo_busy) __wfe();
+}
 
 bool rfm69_irq1_flag_state(rfm69_context_t *rfm, RFM69_IRQ1_FLAG flag, bool *state) {
     uint8_t reg;
@@ -208,10 +633,20 @@ bool rfm69_irq2_flag_state(rfm69_context_t *rfm, RFM69_IRQ2_FLAG flag, bool *sta
     return true;
 }
 
+bool rfm69_irq_flags_get(rfm69_context_t *rfm, rfm69_irq_flags_t *flags) {
+    uint8_t buf[2];
+    if (!rfm69_read(rfm, RFM69_REG_IRQ_FLAGS_1, buf, 2)) return false;
+
+    flags->irq1 = buf[0];
+    flags->irq2 = buf[1];
+
+    return true;
+}
+
 bool rfm69_frequency_set(rfm69_context_t *rfm, uint32_t frequency) {
     // Frf = Fstep * Frf(23,0) frequency *= 1000000; // MHz to Hz
-    frequency *= 1000000;
-    frequency = (frequency / RFM69_FSTEP) + 0.5; // Gives needed register value
+    frequency = RFM69_FRF_FROM_HZ((uint64_t) frequency * 1000000); // Gives needed register value
+    frequency += RFM69_FRF_STEPS_FROM_HZ(rfm->afc_offset);
 												 //
     // Split into three bytes.
     uint8_t buf[3] = {
@@ -230,13 +665,13 @@ bool rfm69_frequency_get(rfm69_context_t *rfm, uint32_t *frequency) {
     *frequency = (uint32_t) buf[0] << 16;
     *frequency |= (uint32_t) buf[1] << 8;
     *frequency |= (uint32_t) buf[2];
-    *frequency *= RFM69_FSTEP;
+    *frequency = RFM69_HZ_FROM_FRF(*frequency);
 
     return true;
 }
 
 bool rfm69_fdev_set(rfm69_context_t *rfm, uint32_t fdev) {
-    fdev = (fdev / RFM69_FSTEP) + 0.5;
+    fdev = RFM69_FDEV_FROM_HZ(fdev);
 
     uint8_t buf[2] = {
         (fdev >> 8) & 0x3F, 
@@ -270,6 +705,39 @@ bool rfm69_bitrate_set(rfm69_context_t *rfm, uint16_t bit_rate) {
     return rfm69_write(rfm, RFM69_REG_BITRATE_MSB, bytes, 2);
 }
 
+// Reads <len> registers from the shadow, or all of them over SPI if any
+// is missing
+static bool _reg_cached_read(rfm69_context_t *rfm, uint8_t address, uint8_t *dst, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		if (!rfm69_shadow_get(rfm, address + i, &dst[i])) return rfm69_read(rfm, address, dst, len);
+	}
+
+	rfm->return_status = RFM69_OK;
+	return true;
+}
+
+bool rfm69_airtime_us(rfm69_context_t *rfm, size_t len, uint32_t *us) {
+	uint8_t bitrate[2];
+	uint8_t preamble[2];
+	uint8_t sync;
+
+	if (!_reg_cached_read(rfm, RFM69_REG_BITRATE_MSB, bitrate, 2)) return false;
+	if (!_reg_cached_read(rfm, RFM69_REG_PREAMBLE_MSB, preamble, 2)) return false;
+	if (!_reg_cached_read(rfm, RFM69_REG_SYNC_CONFIG, &sync, 1)) return false;
+
+	// SyncOn, and SyncSize holds the size - 1
+	uint sync_size = sync & 0x80 ? ((sync & _SYNC_SIZE_MASK) >> _SYNC_SIZE_OFFSET) + 1 : 0;
+	uint64_t bytes = ((uint) preamble[0] << 8 | preamble[1]) + sync_size + len + 2;
+
+	// One bit lasts RegBitrate / FXOSC
+	uint64_t rate = (uint) bitrate[0] << 8 | bitrate[1];
+	uint64_t airtime = (bytes * 8 * rate * 1000000 + RFM69_FXOSC - 1) / RFM69_FXOSC;
+	*us = MIN(airtime, UINT32_MAX);
+
+	rfm->return_status = RFM69_OK;
+	return true;
+}
+
 bool rfm69_bitrate_get(rfm69_context_t *rfm, uint16_t *bit_rate) {
     uint8_t buf[2] = {0}; 
     if (!rfm69_read(rfm, RFM69_REG_BITRATE_MSB, buf, 2)) return false;
@@ -283,6 +751,9 @@ bool rfm69_bitrate_get(rfm69_context_t *rfm, uint16_t *bit_rate) {
 bool rfm69_mode_set(rfm69_context_t *rfm, RFM69_OP_MODE mode) {
 	bool success = false;
 
+	// op_mode is stale while listening, so this comes first
+	if (rfm->listening) return rfm69_listen_stop(rfm, mode);
+
 	// Just return true/OK if we are already in requested mode
 	if (rfm->op_mode == mode) {
 		rfm->return_status = RFM69_OK;
@@ -298,11 +769,23 @@ bool rfm69_mode_set(rfm69_context_t *rfm, RFM69_OP_MODE mode) {
 		if(!_hp_set(rfm, RFM69_HP_ENABLE)) goto RETURN;
 	}
 
+#ifdef RFM69_STATS
+	uint32_t start = time_us_32();
+#endif
+
+	if (!_events_mode_change(rfm, mode)) goto RETURN;
+
 	if (!rfm69_write_masked(rfm, RFM69_REG_OP_MODE, mode, RFM69_OP_MODE_MASK))
 		goto RETURN;
 
 	if (!_mode_wait_until_ready(rfm)) goto RETURN;
 	rfm->op_mode = mode;
+	rfm->fei_started = false;
+
+#ifdef RFM69_STATS
+	rfm->stats.mode_switches++;
+	rfm->stats.mode_switch_us += time_us_32() - start;
+#endif
 	
 	success = true;
 RETURN:
@@ -316,13 +799,41 @@ bool _mode_ready(rfm69_context_t *rfm, bool *ready) {
 }
 
 bool _mode_wait_until_ready(rfm69_context_t *rfm) {
-    bool ready = false;
-    while (!ready) {
-        // Return immediately if there is an spi error
-        if (!_mode_ready(rfm, &ready)) return false;
-    }
+    // Sleeps on the DIO5 interrupt if wired, polls IRQ flags otherwise.
+    // Fails with RFM69_TIMEOUT if the radio never gets there.
+    return rfm69_event_wait(rfm, RFM69_EVENT_MODE_READY, RFM69_MODE_READY_TIMEOUT_US);
+}
 
-    return true;
+bool rfm69_auto_modes_set(
+		rfm69_context_t *rfm,
+		RFM69_AUTO_ENTER enter,
+		RFM69_AUTO_EXIT exit,
+		RFM69_AUTO_INTERMEDIATE intermediate)
+{
+	// mode_set is bypassed on the way into the intermediate mode, so do
+	// its DIO0 and high power work up front
+	if (intermediate == RFM69_AUTO_INTERMEDIATE_TX) {
+		if (!_events_mode_change(rfm, RFM69_OP_MODE_TX)) return false;
+		if (rfm->pa_level >= 17 && !_hp_set(rfm, RFM69_HP_ENABLE)) return false;
+	}
+	else if (intermediate == RFM69_AUTO_INTERMEDIATE_RX) {
+		if (!_events_mode_change(rfm, RFM69_OP_MODE_RX)) return false;
+		if (rfm->pa_level >= 17 && !_hp_set(rfm, RFM69_HP_DISABLE)) return false;
+	}
+
+	uint8_t reg = enter | exit | intermediate;
+	if (!rfm69_write(rfm, RFM69_REG_AUTO_MODES, &reg, 1)) return false;
+
+	rfm->auto_modes = enter == RFM69_AUTO_ENTER_OFF ? 0 : reg;
+	return true;
+}
+
+bool rfm69_auto_modes_clear(rfm69_context_t *rfm) {
+	uint8_t reg = RFM69_AUTO_ENTER_OFF;
+	if (!rfm69_write(rfm, RFM69_REG_AUTO_MODES, &reg, 1)) return false;
+
+	rfm->auto_modes = 0;
+	return true;
 }
 
 bool rfm69_data_mode_set(rfm69_context_t *rfm, RFM69_DATA_MODE mode) {
@@ -419,6 +930,33 @@ bool rfm69_rssi_threshold_set(rfm69_context_t *rfm, uint8_t threshold) {
     );
 }
 
+bool rfm69_rx_timeout_set(rfm69_context_t *rfm, uint8_t rx_start, uint8_t rssi_to_payload) {
+    // RegRxTimeout1 and RegRxTimeout2 are adjacent
+    uint8_t buf[2] = {rx_start, rssi_to_payload};
+
+    return rfm69_write(rfm, RFM69_REG_RX_TIMEOUT_1, buf, 2);
+}
+
+// One timeout unit is 16 bit periods, 16 * RegBitrate / FXOSC.
+// With FXOSC at 32 MHz that is RegBitrate / 2 us.
+static uint8_t _rx_timeout_units(uint32_t us, uint16_t bitrate) {
+    if (us == 0) return 0;
+
+    uint64_t units = ((uint64_t) us * 2 + bitrate - 1) / bitrate;
+    return units > 0xFF ? 0xFF : units;
+}
+
+bool rfm69_rx_timeout_us_set(rfm69_context_t *rfm, uint32_t rx_start_us, uint32_t rssi_to_payload_us) {
+    uint16_t bitrate;
+    if (!rfm69_bitrate_get(rfm, &bitrate)) return false;
+
+    return rfm69_rx_timeout_set(
+            rfm,
+            _rx_timeout_units(rx_start_us, bitrate),
+            _rx_timeout_units(rssi_to_payload_us, bitrate)
+    );
+}
+
 bool rfm69_power_level_set(rfm69_context_t *rfm, int8_t pa_level) {
 	bool success = false;
 
@@ -640,11 +1178,46 @@ bool rfm69_crc_autoclear_set(rfm69_context_t *rfm, bool set) {
     return rfm69_write_masked(
             rfm,
             RFM69_REG_PACKET_CONFIG_1,
-            !set << 7,
+            !set << 3,
             0x08
     );
 }
 
+bool rfm69_aes_set(rfm69_context_t *rfm, bool enable) {
+    if (!rfm69_write_masked(rfm, RFM69_REG_PACKET_CONFIG_2, enable, 0x01))
+        return false;
+
+    rfm->aes_enabled = enable;
+    return true;
+}
+
+bool rfm69_aes_get(rfm69_context_t *rfm, bool *enabled) {
+    uint8_t reg;
+    if (!rfm69_read_masked(rfm, RFM69_REG_PACKET_CONFIG_2, &reg, 0x01))
+        return false;
+
+    *enabled = reg;
+    rfm->aes_enabled = reg;
+    return true;
+}
+
+bool rfm69_aes_key_set(rfm69_context_t *rfm, const uint8_t key[RFM69_AES_KEY_SIZE]) {
+    if (rfm->aes_key_valid && memcmp(rfm->aes_key, key, RFM69_AES_KEY_SIZE) == 0) {
+        rfm->return_status = RFM69_OK;
+        return true;
+    }
+
+    // Forget the old key first in case the write fails halfway
+    rfm->aes_key_valid = false;
+    if (!rfm69_write(rfm, RFM69_REG_AES_KEY_1, key, RFM69_AES_KEY_SIZE))
+        return false;
+
+    memcpy(rfm->aes_key, key, RFM69_AES_KEY_SIZE);
+    rfm->aes_key_valid = true;
+
+    return true;
+}
+
 bool rfm69_dcfree_set(rfm69_context_t *rfm, RFM69_DCFREE_SETTING setting) {
     return rfm69_write_masked(
             rfm,
@@ -684,7 +1257,7 @@ bool rfm69_dio1_config_set(rfm69_context_t *rfm, RFM69_DIO1_CFG dio_config) {
 bool rfm69_dio2_config_set(rfm69_context_t *rfm, RFM69_DIO2_CFG dio_config) {
     return rfm69_write_masked(
             rfm,
-            RFM69_REG_DIO_MAPPING_2,
+            RFM69_REG_DIO_MAPPING_1,
             dio_config,
             RFM69_DIO_2_MASK
     );
@@ -693,7 +1266,7 @@ bool rfm69_dio2_config_set(rfm69_context_t *rfm, RFM69_DIO2_CFG dio_config) {
 bool rfm69_dio3_config_set(rfm69_context_t *rfm, RFM69_DIO3_CFG dio_config) {
     return rfm69_write_masked(
             rfm,
-            RFM69_REG_DIO_MAPPING_2,
+            RFM69_REG_DIO_MAPPING_1,
             dio_config,
             RFM69_DIO_3_MASK
     );
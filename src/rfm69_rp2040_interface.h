@@ -25,9 +25,92 @@
 
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
+#include "hardware/pio.h"
 
 #include "rfm69_rp2040_definitions.h"
 
+// DMA IRQ line (0 or 1) used to signal FIFO DMA completion.
+#ifndef RFM69_DMA_IRQ_INDEX
+#define RFM69_DMA_IRQ_INDEX 0
+#endif
+
+// FIFO accesses shorter than this are not worth the DMA setup and
+// always go out as blocking SPI transfers.
+#ifndef RFM69_FIFO_DMA_MIN_LEN
+#define RFM69_FIFO_DMA_MIN_LEN 8
+#endif
+
+// SCK frequency of the PIO transport when the config leaves it at 0.
+// The RFM69 SPI interface tops out at 10 MHz.
+#ifndef RFM69_PIO_BAUD_DEFAULT
+#define RFM69_PIO_BAUD_DEFAULT (4 * 1000 * 1000)
+#endif
+#define RFM69_PIO_BAUD_MAX (10 * 1000 * 1000)
+
+#define RFM69_AES_KEY_SIZE 16
+
+// Largest variable length packet, length byte included
+#define RFM69_PACKET_MAX 256
+
+// FifoThreshold used while streaming packets larger than the FIFO.
+// Refills happen once the FIFO drains to this many bytes, so it has to
+// cover the refill latency at the bitrate in use.
+#ifndef RFM69_STREAM_FIFO_THRESH
+#define RFM69_STREAM_FIFO_THRESH 16
+#endif
+
+// A packet being received is dropped if the FIFO makes no progress for
+// the air time of RFM69_FIFO_SIZE bytes plus this long.
+#ifndef RFM69_STREAM_RX_STALL_US
+#define RFM69_STREAM_RX_STALL_US 250000
+#endif
+
+// Longest a mode switch may take to reach ModeReady. The slowest, out of
+// Sleep, takes well under 1 ms.
+#ifndef RFM69_MODE_READY_TIMEOUT_US
+#define RFM69_MODE_READY_TIMEOUT_US 10000
+#endif
+
+// Peers remembered by a rfm69_afc_table_t
+#ifndef RFM69_AFC_PEERS_MAX
+#define RFM69_AFC_PEERS_MAX 16
+#endif
+
+// Channels in a rfm69_channel_plan_t
+#ifndef RFM69_HOP_CHANNELS_MAX
+#define RFM69_HOP_CHANNELS_MAX 64
+#endif
+
+// Number of registers mirrored by the register shadow (0x00 -> RegTestAfc)
+#define RFM69_SHADOW_SIZE (RFM69_REG_TEST_AFC + 1)
+
+// Pin value for DIOs that are not connected to the MCU
+#define RFM69_PIN_UNUSED ((uint) -1)
+#define RFM69_DIO_NUM 6
+
+#ifdef RFM69_STATS
+// Traffic for transactions starting at one register. Counters wrap;
+// <us> does so after ~71 minutes of accumulated bus time.
+typedef struct rfm69_reg_stats {
+	uint32_t count; // Transactions
+	uint32_t bytes; // Data bytes moved, address byte excluded
+	uint32_t us;    // Cumulative transaction time
+} rfm69_reg_stats_t;
+
+typedef struct rfm69_stats {
+	rfm69_reg_stats_t write[RFM69_SHADOW_SIZE];
+	rfm69_reg_stats_t read[RFM69_SHADOW_SIZE];
+	uint32_t writes_skipped; // Masked writes the shadow made unnecessary
+	uint32_t mode_switches;
+	uint32_t mode_switch_us; // Including the wait for ModeReady
+} rfm69_stats_t;
+#endif
+
+struct _rfm69_context;
+
+// Called from the DMA IRQ handler once an async FIFO transfer completes.
+typedef void (*rfm69_fifo_callback_t)(struct _rfm69_context *rfm, void *data);
+
 typedef struct _rfm69_context {
     spi_inst_t *spi; // Initialized SPI instance
     uint pin_cs;
@@ -38,12 +121,157 @@ typedef struct _rfm69_context {
 	RFM69_RETURN return_status;
     uint8_t ocp_trim;
 	uint8_t address;
+
+	// Bus backend. pio/pio_sm are only used by RFM69_TRANSPORT_PIO.
+	RFM69_TRANSPORT transport;
+	PIO pio;
+	uint pio_sm;
+
+	// FIFO DMA state. Channels are -1 if DMA is not in use.
+	int dma_tx_chan;
+	int dma_rx_chan;
+	volatile bool fifo_busy;
+	rfm69_fifo_callback_t fifo_callback;
+	void *fifo_callback_data;
+
+	// Shadow of the writable register map. Lets masked writes skip the
+	// read half of read-modify-write. Volatile status registers are
+	// never shadowed.
+	bool shadow_enabled;
+	uint8_t shadow[RFM69_SHADOW_SIZE];
+	uint8_t shadow_valid[(RFM69_SHADOW_SIZE + 7) / 8];
+
+	// DIO event core. pin_dio[n] is RFM69_PIN_UNUSED unless DIOn is
+	// wired, dio_event[n] is the RFM69_EVENT DIOn currently signals and
+	// events holds rising edges latched by the GPIO IRQ.
+	uint pin_dio[RFM69_DIO_NUM];
+	RFM69_EVENT dio_event[RFM69_DIO_NUM];
+	volatile uint32_t events;
+	// time_us_64() of the last PayloadReady edge on a wired DIO0
+	volatile uint64_t payload_ready_us;
+
+	// FIFO overruns seen by rfm69_packet_receive
+	uint32_t fifo_overruns;
+
+	// FeiStart has been written for the packet now arriving (see
+	// _packet_fei_poll). Cleared on mode changes and once it is read.
+	bool fei_started;
+
+	// Carrier correction in Hz added to every RegFrf write made through
+	// rfm69_frequency_set/rfm69_channel_set (see rfm69_afc_offset_set).
+	int32_t afc_offset;
+
+	// Hardware AES state. aes_key mirrors the key registers while
+	// aes_key_valid is set, so reloading the same key costs nothing.
+	bool aes_enabled;
+	bool aes_key_valid;
+	uint8_t aes_key[RFM69_AES_KEY_SIZE];
+
+	// Set while ListenOn is. op_mode holds the mode Listen Mode was
+	// started from (STDBY).
+	bool listening;
+
+	// Last RegAutoModes value written, 0 while AutoModes are off.
+	// op_mode always holds the resting mode, never the intermediate one.
+	uint8_t auto_modes;
+
+#ifdef RFM69_STATS
+	rfm69_stats_t stats;
+	// In-flight FIFO DMA transfer, recorded on completion
+	uint32_t stats_dma_start;
+	uint8_t stats_dma_address;
+	size_t stats_dma_len;
+#endif
 } rfm69_context_t;
 
+// Listen Mode timing. Durations are rounded to the nearest step of the
+// finest resolution (64 us, 4.1 ms, 262 ms) that can express them, up
+// to 255 steps of 262 ms.
+struct rfm69_listen_config_s {
+	uint32_t idle_us; // Sleep between RX windows
+	uint32_t rx_us;   // Length of each RX window
+	RFM69_LISTEN_CRITERIA criteria;
+	RFM69_LISTEN_END end;
+};
+
+// Learned carrier offsets of other radios by node address, so the
+// difference between two crystals can be corrected before talking to a
+// peer instead of being absorbed by a wide RX bandwidth.
+typedef struct rfm69_afc_table {
+	uint8_t address[RFM69_AFC_PEERS_MAX];
+	int32_t offset_hz[RFM69_AFC_PEERS_MAX];
+	uint8_t count;
+	uint8_t next; // Entry replaced next once the table is full
+} rfm69_afc_table_t;
+
+// Channel plan for frequency hopping. FRF bytes are computed once so a
+// hop is a single 3 byte burst. Slots (packet or transfer counters kept
+// in step on both ends) map to channels as
+//
+//   channel = (offset + slot * step) % channels
+//
+// with <step> coprime to <channels>, so every channel is visited once per
+// <channels> slots.
+typedef struct rfm69_channel_plan {
+	uint8_t frf[RFM69_HOP_CHANNELS_MAX][3];
+	uint8_t channels;
+	uint8_t step;
+	uint8_t offset;
+	uint8_t current; // Last channel tuned
+	bool prelock;    // Lock the PLL in FS after hops from SLEEP/STDBY
+} rfm69_channel_plan_t;
+
+// Receive metadata captured at PayloadReady by rfm69_packet_receive_meta.
+// AFC/FEI and RSSI registers are contiguous, so this costs one extra
+// burst read per packet plus starting FEI once the packet begins.
+struct rfm69_packet_meta_s {
+	uint64_t timestamp_us; // PayloadReady, from the DIO0 edge if wired
+	int32_t fei_hz;        // Carrier offset of the sender, if fei_valid
+	int32_t afc_hz;        // AFC correction, meaningful with AFC auto on
+	int16_t rssi;          // dBm
+	bool fei_valid;        // FEI finished while the packet was arriving
+	bool crc_ok;           // Only ever false with CRC autoclear off
+};
+
+// Pins and PIO block for the continuous mode engine
+struct rfm69_cont_config_s {
+	PIO pio;       // NULL -> pio0
+	uint pin_dclk; // GPIO wired to DIO1
+	uint pin_data; // GPIO wired to DIO2
+};
+
+// Continuous mode engine. A PIO state machine clocks DATA on DCLK and a
+// DMA channel moves the bits between it and memory, 32 at a time.
+typedef struct rfm69_cont {
+	rfm69_context_t *rfm;
+	PIO pio;
+	uint sm;
+	uint dma_chan;
+	uint pin_dclk;
+	uint pin_data;
+	uint8_t *ring;     // RX ring buffer, 1 << ring_bits bytes
+	uint ring_bits;
+	uint64_t tail;     // Bytes read out of the ring so far
+	uint32_t overruns; // Times the reader fell a whole ring behind
+} rfm69_cont_t;
+
 struct rfm69_config_s {
 	spi_inst_t *spi;
 	uint pin_cs;
 	uint pin_rst;
+	bool fifo_dma;   // Claim two DMA channels for FIFO transfers
+	bool reg_shadow; // Enable the register shadow
+
+	// RFM69_TRANSPORT_SPI (default) uses <spi> and drives CS from the CPU.
+	// RFM69_TRANSPORT_PIO runs the bus from a PIO state machine on the
+	// pins below, with CS sequenced by the state machine. <spi> is
+	// ignored and the pins need not belong to any SPI block.
+	RFM69_TRANSPORT transport;
+	PIO pio;           // PIO block for the PIO transport (NULL -> pio0)
+	uint pin_miso;
+	uint pin_sck;
+	uint pin_mosi;
+	uint32_t pio_baud; // SCK in Hz (0 -> RFM69_PIO_BAUD_DEFAULT)
 };
 
 // DEPRECATED
@@ -66,8 +294,95 @@ bool rfm69_init(
 // Resets the module by setting the reset pin for 100ms
 // and then waiting an additional 5ms after clearing as per the
 // RFM69HCW datasheet: https://cdn.sparkfun.com/datasheets/Wireless/General/RFM69HCW-V1.1.pdf
+// Invalidates the register shadow.
 void rfm69_reset(rfm69_context_t *rfm);
 
+// Register shadow control.
+// The shadow is filled lazily by reads and kept in sync by every write
+// that goes through rfm69_write. With a valid entry, rfm69_write_masked
+// becomes a single SPI write, and is skipped if nothing would change.
+// IRQ flags, RSSI, FEI/AFC values and other status registers always
+// bypass the shadow.
+//
+// Disabling the shadow also invalidates it.
+void rfm69_shadow_enable(rfm69_context_t *rfm, bool enable);
+
+// Forget all shadowed values. Call this if the radio was changed
+// behind the library's back.
+void rfm69_shadow_invalidate(rfm69_context_t *rfm);
+
+// Refill the whole shadow with a single burst read of the register map.
+bool rfm69_shadow_sync(rfm69_context_t *rfm);
+
+// Returns true and sets <value> if <address> has a valid shadow entry.
+bool rfm69_shadow_get(rfm69_context_t *rfm, uint8_t address, uint8_t *value);
+
+// Sends one packet made up of <head> followed by <body> (either may be
+// empty) and blocks until PacketSent. For variable length packets the
+// length byte is the first byte of <head>.
+//
+// Packets up to RFM69_FIFO_SIZE are written in STDBY before switching to
+// TX. Larger ones, up to RFM69_PACKET_MAX, are streamed: the FIFO is
+// filled, TX is entered and the rest is fed in as FifoLevel drops below
+// RFM69_STREAM_FIFO_THRESH (which is left programmed afterwards). Wire
+// DIO1 with rfm69_dio_pin_set to watch FifoLevel without SPI polling.
+//
+// Leaves the radio in TX, or in the resting mode if AutoModes are set up
+// for TX (see rfm69_auto_modes_set), in which case no mode switches are
+// done at all. Fails with RFM69_TIMEOUT if the packet has not gone out
+// 10 ms past its airtime.
+bool rfm69_packet_send(
+		rfm69_context_t *rfm,
+		const uint8_t *head,
+		size_t head_len,
+		const uint8_t *body,
+		size_t body_len);
+
+// Receives one variable length packet into <dst> (length byte included)
+// and sets <len> to its size. Switches to RX if needed and leaves the
+// radio there.
+//
+// The FIFO is drained on FifoLevel while the packet is still arriving,
+// so packets up to RFM69_PACKET_MAX are received without overrunning the
+// 66 byte FIFO. PayloadLength must allow them. The last FIFO's worth is
+// left for PayloadReady. With CRC autoclear on it is turned off while a
+// packet is drained, and packets failing the CRC are dropped by hand.
+// <timeout_us> bounds the wait for a packet to start; 0 waits forever.
+//
+// Errors:
+// RFM69_TIMEOUT         - nothing arrived, or the packet stalled
+// RFM69_PACKET_OVERFLOW - packet larger than <size>, dropped
+// RFM69_FIFO_OVERRUN    - the FIFO overran, dropped and counted in
+//                         rfm->fifo_overruns
+bool rfm69_packet_receive(
+		rfm69_context_t *rfm,
+		uint8_t *dst,
+		size_t size,
+		size_t *len,
+		uint32_t timeout_us);
+
+// rfm69_packet_receive that also fills <meta> for the packet.
+//
+// FEI needs the signal on air, so it is started as soon as SyncAddress
+// matches. The wait for a packet sleeps on DIO3 (SyncAddress) for that
+// if it is wired, and polls the IRQ flags until then otherwise.
+bool rfm69_packet_receive_meta(
+		rfm69_context_t *rfm,
+		uint8_t *dst,
+		size_t size,
+		size_t *len,
+		uint32_t timeout_us,
+		struct rfm69_packet_meta_s *meta);
+
+// Transaction instrumentation. Built only with RFM69_STATS defined
+// (cmake -DRFM69_STATS=ON); otherwise both calls do nothing.
+// Every rfm69_write/rfm69_read and FIFO DMA transfer is counted against
+// its start register with the bytes moved and the time it took.
+void rfm69_stats_reset(rfm69_context_t *rfm);
+
+// Prints the non-zero counters to stdout, one line per register.
+void rfm69_stats_print(rfm69_context_t *rfm);
+
 // Writes <len> bytes from <src> to RFM69 registers/FIFO over SPI.
 // SPI instance must be initialized before calling.
 // If src len > 1, address will be incremented between each byte (burst write).
@@ -122,6 +437,35 @@ bool rfm69_read_masked(
         uint8_t *dst,
         const uint8_t mask);
 
+// Asynchronous FIFO transfers over DMA.
+// Requires fifo_dma to be set in the config passed to rfm69_init.
+// CS is held low until the transfer completes, at which point the DMA
+// IRQ releases it and calls <callback> (may be NULL) from IRQ context.
+// <src>/<dst> must stay valid until the transfer completes.
+//
+// Any other register access waits for an in flight transfer to finish.
+// rfm69_write/rfm69_read route FIFO accesses of RFM69_FIFO_DMA_MIN_LEN
+// bytes or more through this path and block until completion.
+bool rfm69_fifo_write_async(
+        rfm69_context_t *rfm,
+        const uint8_t *src,
+        size_t len,
+        rfm69_fifo_callback_t callback,
+        void *data);
+
+bool rfm69_fifo_read_async(
+        rfm69_context_t *rfm,
+        uint8_t *dst,
+        size_t len,
+        rfm69_fifo_callback_t callback,
+        void *data);
+
+// Returns true while an async FIFO transfer is in flight.
+bool rfm69_fifo_busy(rfm69_context_t *rfm);
+
+// Sleeps the core (WFE) until any in flight FIFO transfer completes.
+void rfm69_fifo_wait(rfm69_context_t *rfm);
+
 // Reads state of IRQ flags. Each function corresponds with one
 // of the flag registers.
 // flag    - IRQ flag constant you want to check.
@@ -131,8 +475,43 @@ bool rfm69_read_masked(
 bool rfm69_irq1_flag_state(rfm69_context_t *rfm, RFM69_IRQ1_FLAG flag, bool *state);
 bool rfm69_irq2_flag_state(rfm69_context_t *rfm, RFM69_IRQ2_FLAG flag, bool *state);
 
+// Snapshot of both IRQ flag registers
+typedef struct rfm69_irq_flags {
+	uint8_t irq1; // RegIrqFlags1
+	uint8_t irq2; // RegIrqFlags2
+} rfm69_irq_flags_t;
+
+// Reads RegIrqFlags1 and RegIrqFlags2 in a single 2 byte burst.
+// Prefer this over the single flag functions whenever more than one
+// flag is needed.
+bool rfm69_irq_flags_get(rfm69_context_t *rfm, rfm69_irq_flags_t *flags);
+
+// Flag tests on a snapshot. No SPI access.
+static inline bool rfm69_irq1_flag_test(const rfm69_irq_flags_t *flags, RFM69_IRQ1_FLAG flag) {
+	return (flags->irq1 & flag) != 0;
+}
+
+static inline bool rfm69_irq2_flag_test(const rfm69_irq_flags_t *flags, RFM69_IRQ2_FLAG flag) {
+	return (flags->irq2 & flag) != 0;
+}
+
+// Starts FEI if <flags> show a packet that has matched sync but is not
+// all in yet, once per packet. For waits done outside of
+// rfm69_packet_receive_meta, whose capture then counts it.
+bool _packet_fei_poll(rfm69_context_t *rfm, const rfm69_irq_flags_t *flags);
+
+// One burst from RegAfcFei to RegRssiValue into <meta>, for a packet
+// that is all in (<flags> show PayloadReady) but still in the FIFO.
+// <start_us> is when the wait for it began.
+bool _packet_meta_capture(
+		rfm69_context_t *rfm,
+		const rfm69_irq_flags_t *flags,
+		uint64_t start_us,
+		struct rfm69_packet_meta_s *meta);
+
 // Sets the opterating frequency of the module.
 // frequency - desired frequency in MHz.
+// Any AFC offset (rfm69_afc_offset_set) is added on top.
 //
 // Returns number of bytes written. 
 bool rfm69_frequency_set(rfm69_context_t *rfm, uint32_t frequency);
@@ -158,6 +537,11 @@ bool rfm69_bitrate_set(rfm69_context_t *rfm,
 // Reads modem bitrate.
 bool rfm69_bitrate_get(rfm69_context_t *rfm, uint16_t *bit_rate);
 
+// Time on air of a <len> byte packet (length byte included) at the
+// current bitrate: preamble, sync word and CRC on top. Uses the shadow
+// when it holds the registers.
+bool rfm69_airtime_us(rfm69_context_t *rfm, size_t len, uint32_t *us);
+
 // Sets module into a new mode.
 // Blocks until mode is ready.
 bool rfm69_mode_set(rfm69_context_t *rfm, RFM69_OP_MODE mode);
@@ -168,9 +552,265 @@ void rfm69_mode_get(rfm69_context_t *rfm, uint8_t *mode);
 // Checks if current mode is ready.
 bool _mode_ready(rfm69_context_t *rfm, bool *ready);
 
-// Blocks until mode ready IRQ flag is set. 
+// Blocks until mode ready IRQ flag is set, at most RFM69_MODE_READY_TIMEOUT_US.
 bool _mode_wait_until_ready(rfm69_context_t *rfm);
 
+// DIO EVENTS
+//
+// Wiring DIO0 and DIO5 to GPIO lets the library wait for PacketSent,
+// PayloadReady and ModeReady on GPIO interrupts instead of polling the
+// IRQ flag registers over SPI. The mapping of each wired DIO is managed
+// by the library: DIO5 signals ModeReady, DIO0 is switched between
+// PacketSent (TX) and PayloadReady (RX) by rfm69_mode_set, DIO1
+// signals FifoLevel for packet streaming, DIO3 SyncAddress (RX) and
+// DIO4 the RX Timeout.
+// Events whose DIO is not wired fall back to SPI polling.
+//
+// Call after rfm69_init (or rfm69_reset, which clears DIO mappings).
+// Pass RFM69_PIN_UNUSED to disconnect a DIO.
+bool rfm69_dio_pin_set(rfm69_context_t *rfm, uint dio, uint pin);
+
+// Sets <state> if <event> has occurred and consumes it.
+bool rfm69_event_check(rfm69_context_t *rfm, RFM69_EVENT event, bool *state);
+
+// Blocks until <event> occurs, sleeping the core between interrupts when
+// the event's DIO is wired. <timeout_us> of 0 waits forever.
+// Returns false with RFM69_TIMEOUT if the timeout expires.
+bool rfm69_event_wait(rfm69_context_t *rfm, RFM69_EVENT event, uint32_t timeout_us);
+
+// rfm69_event_wait for whichever of <events> (OR of RFM69_EVENT) comes
+// first. All that occurred are consumed and returned in <occurred>.
+// Only sleeps if every one of <events> has its DIO wired.
+bool rfm69_event_wait_any(
+		rfm69_context_t *rfm,
+		uint32_t events,
+		uint32_t timeout_us,
+		uint32_t *occurred
+);
+
+// Drops latched <events> (OR of RFM69_EVENT).
+void rfm69_event_clear(rfm69_context_t *rfm, uint32_t events);
+
+// Reads the current state of a level type event (PacketSent,
+// PayloadReady, FifoLevel) without consuming latched edges. Reads the
+// DIO pin if wired, polls the IRQ flags otherwise.
+bool _event_level(rfm69_context_t *rfm, RFM69_EVENT event, bool *state);
+
+// Forgets all DIO wiring for this context. Called by rfm69_init.
+void _events_reset(rfm69_context_t *rfm);
+
+// Updates DIO0 for a switch into <mode> and clears the ModeReady latch.
+// Must be called right before the OpMode write.
+bool _events_mode_change(rfm69_context_t *rfm, RFM69_OP_MODE mode);
+
+// Stops (or restarts) the IRQ of the pin wired to <dio> while the DIO
+// carries something other than its event. Either way its latched event
+// is dropped.
+void _events_dio_suspend(rfm69_context_t *rfm, uint dio, bool suspend);
+
+// PIO TRANSPORT
+//
+// One transaction (CS assert, address byte, <len> data bytes, CS release)
+// is handed to the state machine as a whole. Either <src> or <dst> may be
+// NULL; missing TX data is sent as 0x00 and RX data is discarded.
+
+// Loads the program and claims a state machine. Called by rfm69_init.
+bool _pio_spi_init(rfm69_context_t *rfm, const struct rfm69_config_s *config);
+
+// Blocking, CPU fed transfer.
+bool _pio_spi_transfer(
+		rfm69_context_t *rfm,
+		uint8_t address,
+		const uint8_t *src,
+		uint8_t *dst,
+		size_t len);
+
+// DMA fed transfer on the context's FIFO DMA channels. Completion is
+// signalled by the RX channel like the SPI DMA path.
+bool _pio_spi_dma_start(
+		rfm69_context_t *rfm,
+		uint8_t address,
+		const uint8_t *src,
+		uint8_t *dst,
+		size_t len);
+
+// AUTO MODES
+//
+// Lets the radio hop into an intermediate mode on <enter> and back to the
+// resting mode (whatever rfm69_mode_set last selected) on <exit> without
+// any SPI traffic. The classic use is a TX burst from STDBY:
+//
+//   rfm69_auto_modes_set(rfm, RFM69_AUTO_ENTER_FIFO_NOT_EMPTY,
+//           RFM69_AUTO_EXIT_PACKET_SENT, RFM69_AUTO_INTERMEDIATE_TX);
+//
+// after which rfm69_packet_send only writes the FIFO and waits. DIO0 is
+// mapped for the intermediate mode. Turn AutoModes off before switching
+// the resting mode to RX or TX yourself.
+bool rfm69_auto_modes_set(
+		rfm69_context_t *rfm,
+		RFM69_AUTO_ENTER enter,
+		RFM69_AUTO_EXIT exit,
+		RFM69_AUTO_INTERMEDIATE intermediate
+);
+
+// Turns AutoModes off.
+bool rfm69_auto_modes_clear(rfm69_context_t *rfm);
+
+// True if AutoModes are set up for FIFO triggered TX bursts.
+static inline bool rfm69_auto_modes_tx(const rfm69_context_t *rfm) {
+	return rfm->auto_modes == (RFM69_AUTO_ENTER_FIFO_NOT_EMPTY
+		| RFM69_AUTO_EXIT_PACKET_SENT
+		| RFM69_AUTO_INTERMEDIATE_TX);
+}
+
+// LISTEN MODE
+//
+// The radio duty cycles between idle and short RX windows on its own and
+// wakes the MCU through DIO0 (PayloadReady) once a packet arrives. Wire
+// DIO0 with rfm69_dio_pin_set to let the core sleep in rfm69_listen_wait.
+
+// Writes RegListen1-3 in one burst.
+// Returns false (RFM69_INVALID_CONFIG) for durations that cannot be
+// expressed.
+bool rfm69_listen_config_set(
+		rfm69_context_t *rfm,
+		const struct rfm69_listen_config_s *config
+);
+
+// Enters Listen Mode from STDBY.
+bool rfm69_listen_start(rfm69_context_t *rfm);
+
+// Blocks until a packet was received in Listen Mode. <timeout_us> of 0
+// waits forever. With RFM69_LISTEN_END_MODE the packet is left in the
+// FIFO for reading after rfm69_listen_stop.
+bool rfm69_listen_wait(rfm69_context_t *rfm, uint32_t timeout_us);
+
+// Leaves Listen Mode (ListenAbort sequence) and switches to <mode>.
+// rfm69_mode_set does the same if called while listening.
+bool rfm69_listen_stop(rfm69_context_t *rfm, RFM69_OP_MODE mode);
+
+// AFC
+//
+// With AFC on, the receiver corrects its LO to each packet's carrier at
+// the start of reception, using the (wider) AFC bandwidth to find it.
+// Offsets learned per peer can then be applied up front so the RX
+// bandwidth only has to cover the modulation.
+
+// Turns automatic AFC at RX start on or off (AfcAutoOn and
+// AfcAutoclearOn, so every packet starts from the uncorrected LO).
+bool rfm69_afc_auto_set(rfm69_context_t *rfm, bool enabled);
+
+// Channel filter bandwidth used while AFC runs (RegAfcBw).
+bool rfm69_afc_bw_set(rfm69_context_t *rfm, RFM69_RXBW_MANTISSA mantissa, uint8_t exponent);
+
+// Moves the carrier by <hz> relative to the frequency last set, and keeps
+// applying it to later rfm69_frequency_set/rfm69_channel_set calls.
+// Register images that set RegFrf reset it to 0.
+bool rfm69_afc_offset_set(rfm69_context_t *rfm, int32_t hz);
+
+// Carrier offset in Hz of a packet relative to our LO: the AFC correction
+// plus FEI if it finished, both as captured at PayloadReady into <meta>
+// by rfm69_packet_receive_meta.
+int32_t rfm69_afc_measure(const struct rfm69_packet_meta_s *meta);
+
+// Empties <table>.
+void rfm69_afc_table_init(rfm69_afc_table_t *table);
+
+// Folds a measurement of <address> into <table>. <measured_hz> is what
+// rfm69_afc_measure returned while rfm->afc_offset was <applied_hz>.
+// Known peers move halfway to the new estimate to ride out noise.
+void rfm69_afc_learn(
+		rfm69_afc_table_t *table,
+		uint8_t address,
+		int32_t applied_hz,
+		int32_t measured_hz
+);
+
+// Looks up the learned offset of <address>. False if unknown.
+bool rfm69_afc_peer_get(const rfm69_afc_table_t *table, uint8_t address, int32_t *hz);
+
+// Applies the learned offset of <address>, or none if it is unknown.
+bool rfm69_afc_peer_apply(rfm69_context_t *rfm, const rfm69_afc_table_t *table, uint8_t address);
+
+// Writes <frf> to RegFrf in one burst, restarting the receiver if in RX.
+bool _frf_write(rfm69_context_t *rfm, uint32_t frf);
+
+// FREQUENCY HOPPING
+//
+// Precomputed FRF channel tables (see rfm69_channel_plan_t) and a slot
+// based hop sequence both ends can follow without exchanging anything
+// but the seed.
+
+// Fills <plan> with <channels> channels <spacing_hz> apart starting at
+// <base_hz>, hopping in order. Returns false if <channels> is 0 or above
+// RFM69_HOP_CHANNELS_MAX.
+bool rfm69_channel_plan_init(
+		rfm69_channel_plan_t *plan,
+		uint32_t base_hz,
+		uint32_t spacing_hz,
+		uint channels
+);
+
+// Overrides a single channel, for irregular channel plans.
+bool rfm69_channel_plan_set(rfm69_channel_plan_t *plan, uint channel, uint32_t hz);
+
+// Derives the hop sequence (step and offset) from <seed>.
+// Both ends have to use the same seed.
+void rfm69_channel_plan_seed(rfm69_channel_plan_t *plan, uint32_t seed);
+
+// Tunes to <channel> with one burst write of RegFrf. In RX the receiver
+// is restarted on the new channel. From SLEEP/STDBY the radio is put in
+// FS to lock the PLL ahead of time if <plan->prelock> is set.
+bool rfm69_channel_set(rfm69_context_t *rfm, rfm69_channel_plan_t *plan, uint channel);
+
+// Channel of <slot> in the hop sequence.
+static inline uint rfm69_hop_channel(const rfm69_channel_plan_t *plan, uint32_t slot) {
+	return (plan->offset + (uint64_t) slot * plan->step) % plan->channels;
+}
+
+// Tunes to the channel of <slot>.
+static inline bool rfm69_hop(rfm69_context_t *rfm, rfm69_channel_plan_t *plan, uint32_t slot) {
+	return rfm69_channel_set(rfm, plan, rfm69_hop_channel(plan, slot));
+}
+
+// CONTINUOUS MODE
+//
+// Raw bitstreams through DIO1 (DCLK) and DIO2 (DATA) with the bit
+// synchronizer on, for framing the packet engine cannot do. Nothing
+// passes through the FIFO so there is no length limit. Sync word,
+// whitening and CRC are up to the caller. Rates up to 300 kbps.
+
+// Loads the PIO programs and claims a state machine and a DMA channel.
+// Returns false if either is not available.
+bool rfm69_cont_init(
+		rfm69_cont_t *cont,
+		rfm69_context_t *rfm,
+		const struct rfm69_cont_config_s *config
+);
+
+// Starts capturing in RX. Bits land MSB first in <ring>, which has to be
+// 1 << <ring_bits> bytes (2^3 -> 2^15) aligned to its size. The DMA
+// wraps around it until rfm69_cont_stop.
+bool rfm69_cont_rx_start(rfm69_cont_t *cont, void *ring, uint ring_bits);
+
+// Bytes captured and not read yet. Captured bytes show up 4 at a time.
+size_t rfm69_cont_available(rfm69_cont_t *cont);
+
+// Copies up to <size> captured bytes to <dst>. If the reader fell more
+// than a ring behind, the oldest half is dropped and overruns counted.
+size_t rfm69_cont_read(rfm69_cont_t *cont, void *dst, size_t size);
+
+// Starts sending <len> bytes (a multiple of 4) MSB first from <src> in TX.
+// <src> has to stay valid until rfm69_cont_tx_busy returns false.
+bool rfm69_cont_tx_start(rfm69_cont_t *cont, const void *src, size_t len);
+
+// True until the radio has taken the last bit.
+bool rfm69_cont_tx_busy(rfm69_cont_t *cont);
+
+// Stops the engine and puts the radio back in STDBY and packet mode.
+// A DIO1 event IRQ, off while DCLK was on the pin, comes back on.
+bool rfm69_cont_stop(rfm69_cont_t *cont);
+
 // Sets module into packet or continuous mode. 
 bool rfm69_data_mode_set(rfm69_context_t *rfm, RFM69_DATA_MODE mode);
 // Read data mode register. For testing. 
@@ -190,6 +830,17 @@ bool rfm69_rssi_measurment_get(rfm69_context_t *rfm, int16_t *rssi);
 bool rfm69_rssi_measurment_start(rfm69_context_t *rfm);
 bool rfm69_rssi_threshold_set(rfm69_context_t *rfm, uint8_t threshold);
 
+// RX timeouts, armed at every RX start. <rx_start> bounds RX start ->
+// RSSI above threshold, <rssi_to_payload> RSSI -> PayloadReady, both in
+// units of 16 bit periods (0 disables). Either one expiring sets the
+// Timeout flag (RFM69_EVENT_TIMEOUT, on DIO4 if wired). The radio stays
+// in RX, leaving RX clears the flag.
+bool rfm69_rx_timeout_set(rfm69_context_t *rfm, uint8_t rx_start, uint8_t rssi_to_payload);
+
+// Same in microseconds at the current bitrate, rounded up and clamped to
+// what the registers can hold (4080 bit periods).
+bool rfm69_rx_timeout_us_set(rfm69_context_t *rfm, uint32_t rx_start_us, uint32_t rssi_to_payload_us);
+
 // Sets power level of module.
 // Low power modules accept power levels -18 -> 13 
 // High power modules accept power levels -2 -> 20
@@ -220,6 +871,17 @@ bool rfm69_sync_value_set(rfm69_context_t *rfm, uint8_t *value, uint8_t size);
 
 bool rfm69_crc_autoclear_set(rfm69_context_t *rfm, bool set);
 
+// Hardware AES-128 (ECB) on the packet payload.
+// With AES on, packets are limited to what the FIFO holds at once
+// (a length byte of at most 65) and rfm69_packet_send will not stream.
+bool rfm69_aes_set(rfm69_context_t *rfm, bool enable);
+bool rfm69_aes_get(rfm69_context_t *rfm, bool *enabled);
+
+// Loads <key> into RegAesKey1-16 with one burst write. Skipped if the
+// radio already holds this key, so switching peers only costs SPI
+// traffic when the key actually changes.
+bool rfm69_aes_key_set(rfm69_context_t *rfm, const uint8_t key[RFM69_AES_KEY_SIZE]);
+
 bool rfm69_dcfree_set(rfm69_context_t *rfm, RFM69_DCFREE_SETTING setting);
 bool rfm69_dagc_set(rfm69_context_t *rfm, RFM69_DAGC_SETTING setting);
 
@@ -0,0 +1,149 @@
+// rfm69_rp2040_listen.c
+// Listen Mode: hardware duty cycled receive
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "rfm69_rp2040_interface.h"
+
+// Longest we wait for STDBY after aborting Listen Mode
+#define _LISTEN_ABORT_TIMEOUT_US 10000
+
+// Step size in us of each RFM69_LISTEN_RESOL, indexed by its value
+static const uint32_t _LISTEN_RESOL_US[] = {0, 64, 4100, 262000};
+
+// Picks the finest resolution that fits <us> into an 8 bit coefficient.
+static bool _listen_duration(uint32_t us, RFM69_LISTEN_RESOL *resol, uint8_t *coef) {
+	for (uint r = RFM69_LISTEN_RESOL_64_US; r <= RFM69_LISTEN_RESOL_262_MS; r++) {
+		uint32_t step = _LISTEN_RESOL_US[r];
+		uint32_t n = (us + step / 2) / step;
+
+		if (n > 255) continue;
+
+		*resol = r;
+		*coef = n ? n : 1;
+		return true;
+	}
+
+	return false;
+}
+
+bool rfm69_listen_config_set(
+		rfm69_context_t *rfm,
+		const struct rfm69_listen_config_s *config
+)
+{
+	RFM69_LISTEN_RESOL resol_idle, resol_rx;
+	uint8_t buf[3];
+
+	if (!_listen_duration(config->idle_us, &resol_idle, &buf[1])
+			|| !_listen_duration(config->rx_us, &resol_rx, &buf[2]))
+	{
+		rfm->return_status = RFM69_INVALID_CONFIG;
+		return false;
+	}
+
+	buf[0] = resol_idle << _LISTEN_RESOL_IDLE_OFFSET
+		| resol_rx << _LISTEN_RESOL_RX_OFFSET
+		| config->criteria
+		| config->end;
+
+	// RegListen1-3 are contiguous
+	return rfm69_write(rfm, RFM69_REG_LISTEN_1, buf, sizeof buf);
+}
+
+bool rfm69_listen_start(rfm69_context_t *rfm) {
+	if (rfm->listening) {
+		rfm->return_status = RFM69_OK;
+		return true;
+	}
+
+	if (!rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY)) return false;
+
+	// RX windows use the RX DIO mapping (DIO0 -> PayloadReady)
+	if (!_events_mode_change(rfm, RFM69_OP_MODE_RX)) return false;
+	rfm69_event_clear(rfm, RFM69_EVENT_PAYLOAD_READY);
+
+	if (!rfm69_write_masked(
+			rfm,
+			RFM69_REG_OP_MODE,
+			RFM69_OP_MODE_LISTEN_ON,
+			RFM69_OP_MODE_LISTEN_ON | RFM69_OP_MODE_LISTEN_ABORT))
+	{
+		return false;
+	}
+
+	rfm->listening = true;
+	return true;
+}
+
+bool rfm69_listen_wait(rfm69_context_t *rfm, uint32_t timeout_us) {
+	return rfm69_event_wait(rfm, RFM69_EVENT_PAYLOAD_READY, timeout_us);
+}
+
+// Polls ModeReady in RegIrqFlags1 with a bounded wait. Its DIO5 edge
+// cannot be relied on here: a ListenEnd exit to STDBY has the radio
+// there already and no new rising edge ever comes.
+static bool _listen_mode_ready_wait(rfm69_context_t *rfm) {
+	absolute_time_t deadline = make_timeout_time_us(_LISTEN_ABORT_TIMEOUT_US);
+	bool ready;
+
+	for (;;) {
+		if (!_mode_ready(rfm, &ready)) return false;
+		if (ready) break;
+
+		if (time_reached(deadline)) {
+			rfm->return_status = RFM69_TIMEOUT;
+			return false;
+		}
+	}
+
+	// Whatever edge did come is spent
+	rfm69_event_clear(rfm, RFM69_EVENT_MODE_READY);
+
+	rfm->return_status = RFM69_OK;
+	return true;
+}
+
+bool rfm69_listen_stop(rfm69_context_t *rfm, RFM69_OP_MODE mode) {
+	if (!rfm->listening) return rfm69_mode_set(rfm, mode);
+
+	const uint8_t mask = RFM69_OP_MODE_LISTEN_ON 
+		| RFM69_OP_MODE_LISTEN_ABORT 
+		| RFM69_OP_MODE_MASK;
+
+	// Per datasheet: clear ListenOn together with ListenAbort and the
+	// new mode, then write the mode again without ListenAbort.
+	if (!_events_mode_change(rfm, RFM69_OP_MODE_STDBY)) return false;
+	if (!rfm69_write_masked(
+			rfm,
+			RFM69_REG_OP_MODE,
+			RFM69_OP_MODE_LISTEN_ABORT | RFM69_OP_MODE_STDBY,
+			mask))
+	{
+		return false;
+	}
+	if (!rfm69_write_masked(rfm, RFM69_REG_OP_MODE, RFM69_OP_MODE_STDBY, mask))
+		return false;
+
+	rfm->listening = false;
+	rfm->op_mode = RFM69_OP_MODE_STDBY;
+	if (!_listen_mode_ready_wait(rfm)) return false;
+
+	// Anything but STDBY goes through the normal path (PA settings, DIO0)
+	return rfm69_mode_set(rfm, mode);
+}
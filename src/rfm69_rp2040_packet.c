@@ -0,0 +1,453 @@
+// rfm69_rp2040_packet.c
+// Packet TX/RX, streaming through the FIFO for packets that do not fit
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "rfm69_rp2040_interface.h"
+#include "rfm69_rp2040_config.h"
+
+// How long a wait that cannot sleep on a DIO edge sleeps between polls.
+// Well under the RFM69_STREAM_FIFO_THRESH bytes of margin at 300 kbps.
+#define _PACKET_POLL_US 100
+
+// Added to a packet's airtime for TX startup and our own latency
+#define _PACKET_TX_SLACK_US 10000
+
+// Sleeps until the next poll, or <deadline> if that is sooner
+static void _packet_poll_sleep(absolute_time_t deadline) {
+	absolute_time_t next = make_timeout_time_us(_PACKET_POLL_US);
+	best_effort_wfe_or_timeout(absolute_time_diff_us(next, deadline) < 0 ? deadline : next);
+}
+
+// Microseconds left until <deadline>, at least 1 so it never reads as
+// "wait forever"
+static uint32_t _packet_remaining_us(absolute_time_t deadline) {
+	int64_t remaining = absolute_time_diff_us(get_absolute_time(), deadline);
+	return remaining < 1 ? 1 : MIN(remaining, UINT32_MAX);
+}
+
+// Writes the next <max> bytes (or whatever is left) of the packet made up
+// of <head> followed by <body>. <sent> tracks progress across calls.
+static bool _packet_fifo_fill(
+		rfm69_context_t *rfm,
+		const uint8_t *head,
+		size_t head_len,
+		const uint8_t *body,
+		size_t body_len,
+		size_t *sent,
+		size_t max)
+{
+	size_t len;
+
+	if (*sent < head_len) {
+		len = MIN(head_len - *sent, max);
+		if (!rfm69_write(rfm, RFM69_REG_FIFO, &head[*sent], len)) return false;
+		*sent += len;
+		max -= len;
+	}
+
+	if (max && *sent >= head_len && *sent - head_len < body_len) {
+		size_t body_sent = *sent - head_len;
+		len = MIN(body_len - body_sent, max);
+		if (!rfm69_write(rfm, RFM69_REG_FIFO, &body[body_sent], len)) return false;
+		*sent += len;
+	}
+
+	return true;
+}
+
+// AutoModes TX: the radio goes back to the resting mode by itself after
+// PacketSent, which also clears the PacketSent flag. Done once the FIFO
+// is empty and the intermediate mode has been left, RFM69_TIMEOUT if
+// that has not happened by <deadline>.
+static bool _packet_auto_tx_wait(rfm69_context_t *rfm, absolute_time_t deadline) {
+	if (rfm->pin_dio[0] != RFM69_PIN_UNUSED
+			&& !rfm69_event_wait(rfm, RFM69_EVENT_PACKET_SENT, _packet_remaining_us(deadline)))
+	{
+		return false;
+	}
+
+	rfm69_irq_flags_t flags;
+	for (;;) {
+		if (!rfm69_irq_flags_get(rfm, &flags)) return false;
+		if (!rfm69_irq1_flag_test(&flags, RFM69_IRQ1_FLAG_AUTO_MODE)
+				&& !rfm69_irq2_flag_test(&flags, RFM69_IRQ2_FLAG_FIFO_NOT_EMPTY))
+			break;
+
+		if (time_reached(deadline)) {
+			rfm->return_status = RFM69_TIMEOUT;
+			return false;
+		}
+		_packet_poll_sleep(deadline);
+	}
+
+	rfm->return_status = RFM69_OK;
+	return true;
+}
+
+bool rfm69_packet_send(
+		rfm69_context_t *rfm,
+		const uint8_t *head,
+		size_t head_len,
+		const uint8_t *body,
+		size_t body_len)
+{
+	size_t total = head_len + body_len;
+	// The AES engine works on the whole FIFO, so there is no streaming
+	if (total > RFM69_PACKET_MAX || (rfm->aes_enabled && total > RFM69_FIFO_SIZE)) {
+		rfm->return_status = RFM69_PACKET_OVERFLOW;
+		return false;
+	}
+
+	bool streaming = total > RFM69_FIFO_SIZE;
+	if (streaming) {
+		if (!rfm69_write_masked(rfm, RFM69_REG_FIFO_THRESH, RFM69_STREAM_FIFO_THRESH, 0x7F))
+			return false;
+	}
+
+	// With AutoModes the first FIFO byte starts TX, no mode switches
+	bool auto_tx = rfm69_auto_modes_tx(rfm);
+
+	// A missed edge or a DIO that is not what we think it is gives up
+	// here instead of hanging
+	uint32_t airtime;
+	if (!rfm69_airtime_us(rfm, total, &airtime)) return false;
+
+	// The FIFO can only be loaded up front outside of TX
+	if (!auto_tx && !rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY)) return false;
+
+	size_t sent = 0;
+	if (!_packet_fifo_fill(rfm, head, head_len, body, body_len, &sent, RFM69_FIFO_SIZE))
+		return false;
+
+	if (!auto_tx && !rfm69_mode_set(rfm, RFM69_OP_MODE_TX)) return false;
+	absolute_time_t deadline = make_timeout_time_us((uint64_t) airtime + _PACKET_TX_SLACK_US);
+
+	// Top the FIFO back up every time it drains to the threshold.
+	// FifoLevel is only low with at most RFM69_STREAM_FIFO_THRESH bytes
+	// left, so the refill always fits. The DIO only interrupts on rising
+	// edges, so the fall is polled.
+	while (sent < total) {
+		for (;;) {
+			bool above;
+			if (!_event_level(rfm, RFM69_EVENT_FIFO_LEVEL, &above)) return false;
+			if (!above) break;
+
+			if (time_reached(deadline)) {
+				rfm->return_status = RFM69_TIMEOUT;
+				return false;
+			}
+			_packet_poll_sleep(deadline);
+		}
+
+		size_t space = RFM69_FIFO_SIZE - RFM69_STREAM_FIFO_THRESH;
+		if (!_packet_fifo_fill(rfm, head, head_len, body, body_len, &sent, space))
+			return false;
+	}
+
+	if (auto_tx) return _packet_auto_tx_wait(rfm, deadline);
+
+	return rfm69_event_wait(rfm, RFM69_EVENT_PACKET_SENT, _packet_remaining_us(deadline));
+}
+
+// Drops whatever is in the FIFO and restarts the receiver
+static void _packet_rx_restart(rfm69_context_t *rfm) {
+	// Writing FifoOverrun clears the FIFO, RestartRx drops the current packet
+	uint8_t overrun = RFM69_IRQ2_FLAG_FIFO_OVERRUN;
+	rfm69_write(rfm, RFM69_REG_IRQ_FLAGS_2, &overrun, 1);
+	rfm69_write_masked(rfm, RFM69_REG_PACKET_CONFIG_2, 0x04, 0x04);
+	rfm->fei_started = false;
+}
+
+bool _packet_fei_poll(rfm69_context_t *rfm, const rfm69_irq_flags_t *flags) {
+	if (rfm->fei_started) return true;
+	if (!rfm69_irq1_flag_test(flags, RFM69_IRQ1_FLAG_SYNC_ADDRESS_MATCH)) return true;
+	// Too late, the signal is gone
+	if (rfm69_irq2_flag_test(flags, RFM69_IRQ2_FLAG_PAYLOAD_READY)) return true;
+
+	if (!rfm69_write_masked(rfm, RFM69_REG_AFC_FEI, RFM69_AFC_FEI_FEI_START, RFM69_AFC_FEI_FEI_START))
+		return false;
+
+	rfm->fei_started = true;
+	return true;
+}
+
+// Blocks until the FIFO has something to drain or <deadline> passes.
+// Sleeps on DIO0/DIO1 if both are wired, polls FifoNotEmpty otherwise.
+// With AES only PayloadReady counts, the FIFO holds ciphertext until the
+// whole packet is in (DIO0 is enough to sleep on). With <fei> FEI is
+// started at SyncAddress, which DIO3 wakes us for if wired. Without it
+// the flags are polled until FEI has been started.
+static bool _packet_rx_wait(rfm69_context_t *rfm, absolute_time_t deadline, bool fei) {
+	bool aes = rfm->aes_enabled;
+	bool wired = rfm->pin_dio[0] != RFM69_PIN_UNUSED
+		&& (aes || rfm->pin_dio[1] != RFM69_PIN_UNUSED);
+	bool sync_wired = rfm->pin_dio[3] != RFM69_PIN_UNUSED;
+	rfm69_irq_flags_t flags;
+	bool state;
+
+	for (;;) {
+		bool fei_pending = fei && !rfm->fei_started;
+		bool sleep = wired && (!fei_pending || sync_wired);
+
+		if (sleep) {
+			if (fei_pending) {
+				if (!_event_level(rfm, RFM69_EVENT_SYNC_ADDRESS, &state)) return false;
+				if (state && (!rfm69_irq_flags_get(rfm, &flags) || !_packet_fei_poll(rfm, &flags)))
+					return false;
+			}
+
+			if (!_event_level(rfm, RFM69_EVENT_PAYLOAD_READY, &state)) return false;
+			if (state) return true;
+			if (!aes) {
+				if (!_event_level(rfm, RFM69_EVENT_FIFO_LEVEL, &state)) return false;
+				if (state) return true;
+			}
+		}
+		else {
+			if (!rfm69_irq_flags_get(rfm, &flags)) return false;
+			if (fei && !_packet_fei_poll(rfm, &flags)) return false;
+
+			uint8_t flag = aes ? RFM69_IRQ2_FLAG_PAYLOAD_READY : RFM69_IRQ2_FLAG_FIFO_NOT_EMPTY;
+			if (rfm69_irq2_flag_test(&flags, flag)) return true;
+		}
+
+		if (time_reached(deadline)) break;
+		if (sleep) best_effort_wfe_or_timeout(deadline);
+	}
+
+	rfm->return_status = RFM69_TIMEOUT;
+	return false;
+}
+
+// One burst from RegAfcFei to RegRssiValue at PayloadReady
+bool _packet_meta_capture(
+		rfm69_context_t *rfm,
+		const rfm69_irq_flags_t *flags,
+		uint64_t start_us,
+		struct rfm69_packet_meta_s *meta)
+{
+	uint64_t now = time_us_64();
+	bool wired = rfm->pin_dio[0] != RFM69_PIN_UNUSED;
+
+	// The IRQ timestamp is only ours if it is from this call
+	uint64_t edge = rfm->payload_ready_us;
+	meta->timestamp_us = wired && edge >= start_us && edge <= now ? edge : now;
+
+	uint8_t buf[RFM69_REG_RSSI_VALUE - RFM69_REG_AFC_FEI + 1];
+	if (!rfm69_read(rfm, RFM69_REG_AFC_FEI, buf, sizeof buf)) return false;
+
+	int16_t fei = (int16_t) (buf[RFM69_REG_FEI_MSB - RFM69_REG_AFC_FEI] << 8
+			| buf[RFM69_REG_FEI_LSB - RFM69_REG_AFC_FEI]);
+
+	// FeiDone stays set from older measurements
+	meta->fei_valid = rfm->fei_started && (buf[0] & RFM69_AFC_FEI_FEI_DONE);
+	meta->fei_hz = meta->fei_valid ? RFM69_HZ_FROM_FRF_STEPS(fei) : 0;
+
+	int16_t afc = (int16_t) (buf[RFM69_REG_AFC_MSB - RFM69_REG_AFC_FEI] << 8
+			| buf[RFM69_REG_AFC_LSB - RFM69_REG_AFC_FEI]);
+	meta->afc_hz = RFM69_HZ_FROM_FRF_STEPS(afc);
+	meta->rssi = -(int16_t) (buf[RFM69_REG_RSSI_VALUE - RFM69_REG_AFC_FEI] >> 1);
+	meta->crc_ok = rfm69_irq2_flag_test(flags, RFM69_IRQ2_FLAG_CRC_OK);
+
+	return true;
+}
+
+// Drains the packet that has started coming in into <dst>. Only what the
+// FIFO could not hold is read ahead: the length byte, then anything more
+// than a FIFO's worth. The rest waits for PayloadReady, and so for the
+// CRC check, which is returned in <crc_ok>.
+static bool _packet_drain(
+		rfm69_context_t *rfm,
+		uint8_t *dst,
+		size_t size,
+		size_t *len,
+		uint32_t stall_us,
+		uint64_t start_us,
+		struct rfm69_packet_meta_s *meta,
+		bool *crc_ok)
+{
+	size_t got = 0;
+	size_t total = 1; // Just the length byte until it has been read
+	absolute_time_t stall_time = make_timeout_time_us(stall_us);
+	rfm69_irq_flags_t flags;
+	bool captured = false;
+
+	// One flag snapshot per pass tells us how much can safely be read
+	while (got < total) {
+		if (!rfm69_irq_flags_get(rfm, &flags)) return false;
+
+		if (rfm69_irq2_flag_test(&flags, RFM69_IRQ2_FLAG_FIFO_OVERRUN)) {
+			rfm->fifo_overruns++;
+			_packet_rx_restart(rfm);
+			rfm->return_status = RFM69_FIFO_OVERRUN;
+			return false;
+		}
+
+		// Measure the carrier offset while the packet is still on air
+		if (meta && !captured && !_packet_fei_poll(rfm, &flags)) return false;
+
+		size_t n = 0;
+		// The rest of the packet is in the FIFO
+		if (rfm69_irq2_flag_test(&flags, RFM69_IRQ2_FLAG_PAYLOAD_READY)) {
+			if (meta && !captured) {
+				if (!_packet_meta_capture(rfm, &flags, start_us, meta)) return false;
+				captured = true;
+			}
+			*crc_ok = rfm69_irq2_flag_test(&flags, RFM69_IRQ2_FLAG_CRC_OK);
+			n = total - got;
+		}
+		// AES packets fit the FIFO and are only decrypted once all of
+		// it is in, nothing can be read early
+		else if (rfm->aes_enabled)
+			n = 0;
+		// More than RFM69_STREAM_FIFO_THRESH bytes are waiting
+		else if (rfm69_irq2_flag_test(&flags, RFM69_IRQ2_FLAG_FIFO_LEVEL)
+				&& (got == 0 || total - got > RFM69_FIFO_SIZE))
+			n = MIN(RFM69_STREAM_FIFO_THRESH, total - got);
+
+		if (n == 0) {
+			// Lost sync, or the sender stopped
+			if (time_reached(stall_time)) {
+				_packet_rx_restart(rfm);
+				rfm->return_status = RFM69_TIMEOUT;
+				return false;
+			}
+			_packet_poll_sleep(stall_time);
+			continue;
+		}
+
+		if (!rfm69_read(rfm, RFM69_REG_FIFO, &dst[got], n)) return false;
+
+		if (got == 0) {
+			total = 1 + dst[0];
+			if (total > size) {
+				_packet_rx_restart(rfm);
+				rfm->return_status = RFM69_PACKET_OVERFLOW;
+				return false;
+			}
+		}
+
+		got += n;
+		stall_time = make_timeout_time_us(stall_us);
+	}
+
+	// Edges latched while streaming belong to this packet, and so does
+	// the FEI started for it
+	rfm69_event_clear(rfm, RFM69_EVENT_PAYLOAD_READY | RFM69_EVENT_FIFO_LEVEL | RFM69_EVENT_SYNC_ADDRESS);
+	rfm->fei_started = false;
+
+	*len = got;
+	rfm->return_status = RFM69_OK;
+	return true;
+}
+
+// Reads RegPacketConfig1 from the shadow, or over SPI if it is not there
+static bool _packet_config_1_get(rfm69_context_t *rfm, uint8_t *config) {
+	if (rfm69_shadow_get(rfm, RFM69_REG_PACKET_CONFIG_1, config)) return true;
+	return rfm69_read(rfm, RFM69_REG_PACKET_CONFIG_1, config, 1);
+}
+
+static bool _packet_receive(
+		rfm69_context_t *rfm,
+		uint8_t *dst,
+		size_t size,
+		size_t *len,
+		uint32_t timeout_us,
+		struct rfm69_packet_meta_s *meta)
+{
+	if (size == 0) {
+		rfm->return_status = RFM69_PACKET_OVERFLOW;
+		return false;
+	}
+
+	uint64_t start_us = time_us_64();
+	absolute_time_t deadline = timeout_us ? make_timeout_time_us(timeout_us) : at_the_end_of_time;
+
+	if (!rfm69_write_masked(rfm, RFM69_REG_FIFO_THRESH, RFM69_STREAM_FIFO_THRESH, 0x7F))
+		return false;
+	if (!rfm69_mode_set(rfm, RFM69_OP_MODE_RX)) return false;
+
+	// CRC autoclear empties the FIFO while the length byte may already
+	// have been read, and the next packet would be appended to it. It is
+	// turned off once a packet starts, before anything is read, and
+	// failed packets are dropped here instead.
+	bool autoclear = false;
+	uint32_t stall_us = 0;
+	bool ok;
+
+	for (;;) {
+		ok = _packet_rx_wait(rfm, deadline, meta != NULL);
+		if (!ok) break;
+
+		if (stall_us == 0) {
+			uint8_t config;
+			ok = _packet_config_1_get(rfm, &config);
+			if (!ok) break;
+
+			if ((config & 0x10) && !(config & 0x08)) {
+				ok = rfm69_crc_autoclear_set(rfm, false);
+				if (!ok) break;
+				autoclear = true;
+			}
+
+			// Nothing is read while a FIFO's worth comes in
+			ok = rfm69_airtime_us(rfm, RFM69_FIFO_SIZE, &stall_us);
+			if (!ok) break;
+			stall_us += RFM69_STREAM_RX_STALL_US;
+		}
+
+		bool crc_ok = false;
+		ok = _packet_drain(rfm, dst, size, len, stall_us, start_us, meta, &crc_ok);
+		if (!ok || !autoclear || crc_ok) break;
+
+		// What autoclear would have done, then back to listening
+		_packet_rx_restart(rfm);
+		rfm69_event_clear(rfm, RFM69_EVENT_PAYLOAD_READY | RFM69_EVENT_FIFO_LEVEL | RFM69_EVENT_SYNC_ADDRESS);
+	}
+
+	if (autoclear) {
+		RFM69_RETURN status = rfm->return_status;
+		bool restored = rfm69_crc_autoclear_set(rfm, true);
+		if (!ok || restored) rfm->return_status = status;
+		ok = ok && restored;
+	}
+
+	return ok;
+}
+
+bool rfm69_packet_receive(
+		rfm69_context_t *rfm,
+		uint8_t *dst,
+		size_t size,
+		size_t *len,
+		uint32_t timeout_us)
+{
+	return _packet_receive(rfm, dst, size, len, timeout_us, NULL);
+}
+
+bool rfm69_packet_receive_meta(
+		rfm69_context_t *rfm,
+		uint8_t *dst,
+		size_t size,
+		size_t *len,
+		uint32_t timeout_us,
+		struct rfm69_packet_meta_s *meta)
+{
+	return _packet_receive(rfm, dst, size, len, timeout_us, meta);
+}
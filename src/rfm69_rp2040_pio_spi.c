@@ -0,0 +1,159 @@
+// rfm69_rp2040_pio_spi.c
+// PIO SPI transport with hardware chip select sequencing
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "rfm69_rp2040_interface.h"
+#include "rfm69_rp2040_spi.pio.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+
+// The program is shared by every state machine on a PIO block
+static uint _program_offset[NUM_PIOS];
+static uint _program_loaded = 0; // Bit n set once loaded on PIO n
+
+// Source of dummy bytes for reads, sink for discarded bytes on writes
+static const uint8_t _pio_zero = 0x00;
+static uint8_t _pio_sink;
+
+bool _pio_spi_init(rfm69_context_t *rfm, const struct rfm69_config_s *config) {
+	PIO pio = config->pio ? config->pio : pio0;
+	uint pio_index = pio_get_index(pio);
+
+	if (!(_program_loaded & (1u << pio_index))) {
+		if (!pio_can_add_program(pio, &rfm69_spi_program)) return false;
+		_program_offset[pio_index] = pio_add_program(pio, &rfm69_spi_program);
+		_program_loaded |= 1u << pio_index;
+	}
+	uint offset = _program_offset[pio_index];
+
+	int sm = pio_claim_unused_sm(pio, false);
+	if (sm < 0) return false;
+
+	uint32_t baud = config->pio_baud ? config->pio_baud : RFM69_PIO_BAUD_DEFAULT;
+	if (baud > RFM69_PIO_BAUD_MAX) baud = RFM69_PIO_BAUD_MAX;
+
+	pio_sm_config c = rfm69_spi_program_get_default_config(offset);
+	sm_config_set_out_pins(&c, config->pin_mosi, 1);
+	sm_config_set_in_pins(&c, config->pin_miso);
+	sm_config_set_set_pins(&c, config->pin_cs, 1);
+	sm_config_set_sideset_pins(&c, config->pin_sck);
+	// MSB first, no autopull/autopush. See rfm69_rp2040_spi.pio.
+	sm_config_set_out_shift(&c, false, false, 32);
+	sm_config_set_in_shift(&c, false, false, 32);
+	// The program spends 4 cycles per bit
+	sm_config_set_clkdiv(&c, (float) clock_get_hz(clk_sys) / (4.0f * baud));
+
+	uint32_t out_mask = (1u << config->pin_cs)
+		| (1u << config->pin_sck)
+		| (1u << config->pin_mosi);
+
+	// CS idles high, SCK idles low (mode 0)
+	pio_sm_set_pins_with_mask(pio, sm, 1u << config->pin_cs, out_mask);
+	pio_sm_set_pindirs_with_mask(pio, sm, out_mask, out_mask | (1u << config->pin_miso));
+
+	pio_gpio_init(pio, config->pin_cs);
+	pio_gpio_init(pio, config->pin_sck);
+	pio_gpio_init(pio, config->pin_mosi);
+	pio_gpio_init(pio, config->pin_miso);
+
+	pio_sm_init(pio, sm, offset, &c);
+	pio_sm_set_enabled(pio, sm, true);
+
+	rfm->pio = pio;
+	rfm->pio_sm = sm;
+
+	return true;
+}
+
+// Queues the transaction header and address byte, then discards the
+// byte clocked in while the address went out.
+static void _pio_spi_begin(rfm69_context_t *rfm, uint8_t address, size_t len) {
+	// Byte count - 1, address included
+	pio_sm_put_blocking(rfm->pio, rfm->pio_sm, len);
+	pio_sm_put_blocking(rfm->pio, rfm->pio_sm, (uint32_t) address << 24);
+	pio_sm_get_blocking(rfm->pio, rfm->pio_sm);
+}
+
+bool _pio_spi_transfer(
+		rfm69_context_t *rfm,
+		uint8_t address,
+		const uint8_t *src,
+		uint8_t *dst,
+		size_t len)
+{
+	PIO pio = rfm->pio;
+	uint sm = rfm->pio_sm;
+
+	_pio_spi_begin(rfm, address, len);
+
+	// Keep the TX FIFO topped up so SCK does not stall between bytes,
+	// but never run more than a FIFO's worth ahead of the reads.
+	size_t tx = 0;
+	size_t rx = 0;
+	while (rx < len) {
+		if (tx < len && tx - rx < 4 && !pio_sm_is_tx_fifo_full(pio, sm)) {
+			pio_sm_put(pio, sm, (uint32_t) (src ? src[tx] : 0x00) << 24);
+			tx++;
+		}
+
+		if (!pio_sm_is_rx_fifo_empty(pio, sm)) {
+			uint8_t byte = pio_sm_get(pio, sm);
+			if (dst) dst[rx] = byte;
+			rx++;
+		}
+	}
+
+	return true;
+}
+
+bool _pio_spi_dma_start(
+		rfm69_context_t *rfm,
+		uint8_t address,
+		const uint8_t *src,
+		uint8_t *dst,
+		size_t len)
+{
+	PIO pio = rfm->pio;
+	uint sm = rfm->pio_sm;
+	uint tx = rfm->dma_tx_chan;
+	uint rx = rfm->dma_rx_chan;
+
+	// 8 bit writes to the TX FIFO are replicated across the word, which
+	// puts each byte in the top of the OSR where the program expects it.
+	dma_channel_config c = dma_channel_get_default_config(tx);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+	channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+	channel_config_set_read_increment(&c, src != NULL);
+	channel_config_set_write_increment(&c, false);
+	dma_channel_configure(tx, &c, &pio->txf[sm], src ? src : &_pio_zero, len, false);
+
+	// Received bytes sit in the low 8 bits of each RX FIFO word
+	c = dma_channel_get_default_config(rx);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+	channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, dst != NULL);
+	dma_channel_configure(rx, &c, dst ? dst : &_pio_sink, &pio->rxf[sm], len, false);
+
+	_pio_spi_begin(rfm, address, len);
+
+	dma_start_channel_mask((1u << tx) | (1u << rx));
+
+	return true;
+}
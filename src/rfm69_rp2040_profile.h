@@ -0,0 +1,126 @@
+// rfm69_rp2040_profile.h
+// Radio profiles compiled into register images at build time
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Everything here is an integer constant expression, so a profile ends up
+// as a static const rfm69_reg_image_t in flash with no math at runtime.
+// Invalid combinations fail the build instead of misconfiguring the radio.
+//
+//   RFM69_PROFILE(
+//           profile_915_57k6,
+//           915000000,                 // Frequency Hz
+//           57600,                     // Bitrate bps
+//           60000,                     // Fdev Hz
+//           RFM69_RXBW_MANTISSA_20, 2, // RxBw 100 kHz
+//           RFM69_PACKET_VARIABLE
+//   );
+//
+//   rfm69_reg_image_apply(&rfm, &profile_915_57k6);
+//
+// Profiles are file scope declarations (a sequence of _Static_asserts
+// and the image itself).
+
+#ifndef RFM69_RP2040_PROFILE_H
+#define RFM69_RP2040_PROFILE_H
+
+#include "rfm69_rp2040_config.h"
+
+// Register values. Frf and Fdev use RFM69_FRF_FROM_HZ and
+// RFM69_FDEV_FROM_HZ so profiles match the runtime setters byte for byte.
+#define RFM69_BITRATE_FROM_BPS(bps) (((uint32_t) RFM69_FXOSC + (bps) / 2) / (bps))
+
+// RxBw mantissa register field -> 16, 20 or 24
+#define RFM69_RXBW_MANTISSA_VALUE(mantissa) (16 + 4 * ((mantissa) >> _RXBW_MANTISSA_OFFSET))
+
+// Single sideband channel filter bandwidth in Hz (FSK)
+#define RFM69_RXBW_HZ(mantissa, exponent) \
+	((uint32_t) RFM69_FXOSC / (RFM69_RXBW_MANTISSA_VALUE(mantissa) * (4u << (exponent))))
+
+// Frequency bands covered by the RFM69 family
+#define RFM69_PROFILE_FREQUENCY_OK(hz) \
+	(((hz) >= 290000000 && (hz) <= 340000000) \
+	 || ((hz) >= 424000000 && (hz) <= 510000000) \
+	 || ((hz) >= 862000000 && (hz) <= 1020000000))
+
+// Modulation index beta = 2 * Fdev / BR has to stay within 0.5 -> 10
+#define RFM69_PROFILE_BETA_OK(fdev, bps) \
+	(4ull * (fdev) >= (bps) && (fdev) <= 5ull * (bps))
+
+// Compile time checks for the modem half of a profile
+#define RFM69_PROFILE_MODEM_ASSERT(name, bps, fdev, rxbw_mantissa, rxbw_exponent) \
+	_Static_assert((bps) >= 1200 && (bps) <= 300000, \
+			#name ": bitrate outside 1.2 -> 300 kbps"); \
+	_Static_assert(RFM69_FDEV_FROM_HZ(fdev) <= 0x3FFF, \
+			#name ": fdev does not fit in RegFdev"); \
+	_Static_assert((fdev) + (bps) / 2 <= 500000, \
+			#name ": fdev + bitrate / 2 above 500 kHz"); \
+	_Static_assert(RFM69_PROFILE_BETA_OK(fdev, bps), \
+			#name ": modulation index (2 * fdev / bitrate) outside 0.5 -> 10"); \
+	_Static_assert((rxbw_exponent) <= 7, \
+			#name ": rxbw exponent above 7"); \
+	_Static_assert((fdev) + (bps) / 2 <= RFM69_RXBW_HZ(rxbw_mantissa, rxbw_exponent), \
+			#name ": rx bandwidth narrower than fdev + bitrate / 2")
+
+// Designated initializers for the modem registers
+#define _PROFILE_MODEM_VALUE(bps, fdev, rxbw_mantissa, rxbw_exponent) \
+	[RFM69_REG_BITRATE_MSB] = (RFM69_BITRATE_FROM_BPS(bps) >> 8) & 0xFF, \
+	[RFN69_REG_BITRATE_LSB] = RFM69_BITRATE_FROM_BPS(bps) & 0xFF, \
+	[RFM69_REG_FDEV_MSB]    = (RFM69_FDEV_FROM_HZ(fdev) >> 8) & 0x3F, \
+	[RFM69_REG_FDEV_LSB]    = RFM69_FDEV_FROM_HZ(fdev) & 0xFF, \
+	[RFM69_REG_RXBW]        = (rxbw_mantissa) | (rxbw_exponent)
+
+#define _PROFILE_MODEM_MASK \
+	[RFM69_REG_BITRATE_MSB] = 0xFF, \
+	[RFN69_REG_BITRATE_LSB] = 0xFF, \
+	[RFM69_REG_FDEV_MSB]    = 0xFF, \
+	[RFM69_REG_FDEV_LSB]    = 0xFF, \
+	[RFM69_REG_RXBW]        = RFM69_RXBW_MANTISSA_MASK | RFM69_RXBW_EXPONENT_MASK
+
+// Bitrate, fdev and rx bandwidth only. Everything else is left untouched
+// when the image is applied, so it works for switching data rates.
+#define RFM69_PROFILE_MODEM(name, bps, fdev, rxbw_mantissa, rxbw_exponent) \
+	RFM69_PROFILE_MODEM_ASSERT(name, bps, fdev, rxbw_mantissa, rxbw_exponent); \
+	static const rfm69_reg_image_t name = { \
+		.value = { _PROFILE_MODEM_VALUE(bps, fdev, rxbw_mantissa, rxbw_exponent) }, \
+		.mask  = { _PROFILE_MODEM_MASK } \
+	}
+
+// Full profile: carrier frequency, modem and packet format.
+#define RFM69_PROFILE(name, hz, bps, fdev, rxbw_mantissa, rxbw_exponent, packet_format) \
+	_Static_assert(RFM69_PROFILE_FREQUENCY_OK(hz), \
+			#name ": frequency outside the RFM69 bands"); \
+	RFM69_PROFILE_MODEM_ASSERT(name, bps, fdev, rxbw_mantissa, rxbw_exponent); \
+	static const rfm69_reg_image_t name = { \
+		.value = { \
+			_PROFILE_MODEM_VALUE(bps, fdev, rxbw_mantissa, rxbw_exponent), \
+			[RFM69_REG_FRF_MSB]         = (RFM69_FRF_FROM_HZ(hz) >> 16) & 0xFF, \
+			[RFM69_REG_FRF_MID]         = (RFM69_FRF_FROM_HZ(hz) >> 8) & 0xFF, \
+			[RFM69_REG_FRF_LSB]         = RFM69_FRF_FROM_HZ(hz) & 0xFF, \
+			[RFM69_REG_PACKET_CONFIG_1] = (packet_format) \
+		}, \
+		.mask = { \
+			_PROFILE_MODEM_MASK, \
+			[RFM69_REG_FRF_MSB]         = 0xFF, \
+			[RFM69_REG_FRF_MID]         = 0xFF, \
+			[RFM69_REG_FRF_LSB]         = 0xFF, \
+			[RFM69_REG_PACKET_CONFIG_1] = 0x80 \
+		} \
+	}
+
+#endif // RFM69_RP2040_PROFILE_H
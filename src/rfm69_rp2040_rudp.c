@@ -20,6 +20,7 @@
 
 #include <stdlib.h>
 #include "rfm69_rp2040_rudp.h"
+#include "rfm69_rp2040_profile.h"
 #include "pico/rand.h"
 #include "string.h"
 
@@ -29,20 +30,45 @@
 
 
 // BAUD SETTINGS
-// These delay settings correspond with a BAUD rate set by user 
-// Only one BAUD available currently: 57.6 KB/s
+// Modem registers for each BAUD rate set by user, built at compile time
+// (see rfm69_rp2040_profile.h). Beta stays around 2 up to 153.6 kbps and
+// drops to 1 above that to fit the 500 kHz limit. Low rates get some
+// extra RxBw to tolerate crystal offset.
+
+RFM69_PROFILE_MODEM(_rudp_modem_1_2,     1200,   5000, RFM69_RXBW_MANTISSA_24, 4); // 20.8 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_2_4,     2400,   5000, RFM69_RXBW_MANTISSA_24, 4); // 20.8 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_4_8,     4800,   5000, RFM69_RXBW_MANTISSA_24, 4); // 20.8 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_9_6,     9600,  10000, RFM69_RXBW_MANTISSA_16, 4); // 31.3 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_19_2,   19200,  20000, RFM69_RXBW_MANTISSA_20, 3); // 50 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_38_4,   38400,  40000, RFM69_RXBW_MANTISSA_24, 2); // 83.3 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_57_6,   57600,  60000, RFM69_RXBW_MANTISSA_20, 2); // 100 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_76_8,   76800,  80000, RFM69_RXBW_MANTISSA_24, 1); // 166.7 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_115_2, 115200, 120000, RFM69_RXBW_MANTISSA_20, 1); // 200 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_153_6, 153600, 160000, RFM69_RXBW_MANTISSA_16, 1); // 250 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_200,   200000, 100000, RFM69_RXBW_MANTISSA_16, 1); // 250 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_250,   250000, 125000, RFM69_RXBW_MANTISSA_24, 0); // 333.3 kHz
+RFM69_PROFILE_MODEM(_rudp_modem_300,   300000, 150000, RFM69_RXBW_MANTISSA_20, 0); // 400 kHz
 
 typedef struct baud_settings {
-	uint fdev;
-	RFM69_MODEM_BITRATE bitrate;	
-	uint pp_delay; // per-packet delay us
-	RFM69_RXBW_MANTISSA rxbw_mantissa;
-	uint rxbw_exp;
+	const rfm69_reg_image_t *modem;
+	uint bitrate;        // bps, for airtime
+	int16_t sensitivity; // dBm, approximate, for adaptive data rate
 } baud_settings_t;
 
 const baud_settings_t BAUD_SETTINGS_LOOKUP[RUDP_BAUD_NUM] = {
-	// RUDP_BAUD_57_6, ~2 beta, 12000 us PPD
-	{60000, RFM69_MODEM_BITRATE_57_6, 12000, RFM69_RXBW_MANTISSA_20, 2} 
+	{&_rudp_modem_1_2,     1200, -118},
+	{&_rudp_modem_2_4,     2400, -115},
+	{&_rudp_modem_4_8,     4800, -112},
+	{&_rudp_modem_9_6,     9600, -109},
+	{&_rudp_modem_19_2,   19200, -106},
+	{&_rudp_modem_38_4,   38400, -103},
+	{&_rudp_modem_57_6,   57600, -101},
+	{&_rudp_modem_76_8,   76800, -100},
+	{&_rudp_modem_115_2, 115200,  -98},
+	{&_rudp_modem_153_6, 153600,  -97},
+	{&_rudp_modem_200,   200000,  -95},
+	{&_rudp_modem_250,   250000,  -94},
+	{&_rudp_modem_300,   300000,  -93},
 };
 
 
@@ -57,6 +83,22 @@ const baud_settings_t BAUD_SETTINGS_LOOKUP[RUDP_BAUD_NUM] = {
 //	free(context);
 //}
 
+// Applies the modem image for <baud>, merged with <config> if not NULL
+static bool _rudp_baud_apply(
+		rfm69_context_t *rfm,
+		rudp_baud_t baud,
+		const struct rfm69_radio_config_s *config)
+{
+	rfm69_reg_image_t image = *BAUD_SETTINGS_LOOKUP[baud].modem;
+
+	if (config && !rfm69_config_compile(config, &image)) {
+		rfm->return_status = RFM69_INVALID_CONFIG;
+		return false;
+	}
+
+	return rfm69_reg_image_apply(rfm, &image);
+}
+
 bool rfm69_rudp_init(rudp_context_t *context, rfm69_context_t *rfm) {
 	context->rfm = rfm;
 
@@ -70,16 +112,32 @@ bool rfm69_rudp_init(rudp_context_t *context, rfm69_context_t *rfm) {
 	context->rx_timeout = 30000; // 30s rx timeout
 
 	context->tx_retries = 5;
-	
-	if (!rfm69_rudp_baud_set(context, RUDP_BAUD_57_6)) return false;
 
+	context->segment_size = PAYLOAD_MAX;
+	context->rx_listen = false;
+	context->adapt = false;
+	context->adapt_max = RUDP_BAUD_57_6;
+	context->adapt_cap = RUDP_BAUD_57_6;
+	context->rx_meta = NULL;
+	context->rx_meta_count = 0;
+	context->afc = NULL;
+	
 	// some rfm69 sane default settings
 	// address and power level should be set directly through radio
 	// todo: add power level negotiation to protocol for first
 	// communication with external radio
-    rfm69_dcfree_set(rfm, RFM69_DCFREE_WHITENING);
-	rfm69_packet_format_set(rfm, RFM69_PACKET_VARIABLE);
-	rfm69_payload_length_set(rfm, PAYLOAD_MAX);
+	struct rfm69_radio_config_s config = {
+		.fields = RFM69_CONFIG_DCFREE
+			| RFM69_CONFIG_PACKET_FORMAT
+			| RFM69_CONFIG_PAYLOAD_LENGTH,
+		.dcfree = RFM69_DCFREE_WHITENING,
+		.packet_format = RFM69_PACKET_VARIABLE,
+		// Only a maximum in variable length mode. Let streamed
+		// segments of any size through.
+		.payload_length = RFM69_PACKET_MAX - 1,
+	};
+	if (!_rudp_baud_apply(rfm, RUDP_BAUD_57_6, &config)) return false;
+	context->baud = RUDP_BAUD_57_6;
 
 	rfm69_mode_set(rfm, RFM69_OP_MODE_SLEEP);
 	return true;
@@ -88,11 +146,7 @@ bool rfm69_rudp_init(rudp_context_t *context, rfm69_context_t *rfm) {
 bool rfm69_rudp_baud_set(rudp_context_t *context, rudp_baud_t baud) {
 	if (baud < 0 || baud >= RUDP_BAUD_NUM) return false;
 
-	baud_settings_t bs = BAUD_SETTINGS_LOOKUP[baud];
-
-    if (!rfm69_fdev_set(context->rfm, bs.fdev)) return false;
-    if (!rfm69_bitrate_set(context->rfm, bs.bitrate)) return false;
-    if (!rfm69_rxbw_set(context->rfm, bs.rxbw_mantissa, bs.rxbw_exp));
+	if (!_rudp_baud_apply(context->rfm, baud, NULL)) return false;
 
 	context->baud = baud;
 
@@ -150,6 +204,62 @@ bool rfm69_rudp_address_set(rudp_context_t *context, uint8_t address) {
 	return rfm69_node_address_set(context->rfm, address);
 }
 
+bool rfm69_rudp_segment_size_set(rudp_context_t *context, uint size) {
+	if (size < 1 || size > SEGMENT_MAX) return false;
+
+	context->segment_size = size;
+	return true;
+}
+
+uint rfm69_rudp_segment_size_get(const rudp_context_t *context) {
+	return context->segment_size;
+}
+
+bool rfm69_rudp_rx_listen_set(
+		rudp_context_t *context,
+		const struct rfm69_listen_config_s *config
+)
+{
+	if (config == NULL) {
+		context->rx_listen = false;
+		return true;
+	}
+
+	// Drop to standby once the RBT is in, the packet stays in the FIFO
+	struct rfm69_listen_config_s listen = *config;
+	listen.end = RFM69_LISTEN_END_MODE;
+
+	if (!rfm69_listen_config_set(context->rfm, &listen)) return false;
+
+	context->rx_listen = true;
+	return true;
+}
+
+void rfm69_rudp_rx_meta_set(
+		rudp_context_t *context,
+		struct rfm69_packet_meta_s *meta,
+		uint count
+)
+{
+	context->rx_meta = meta;
+	context->rx_meta_count = meta ? count : 0;
+}
+
+bool rfm69_rudp_adapt_set(rudp_context_t *context, bool enabled, rudp_baud_t max) {
+	if (max < 0 || max >= RUDP_BAUD_NUM) return false;
+
+	context->adapt = enabled;
+	context->adapt_max = max;
+	context->adapt_cap = max;
+	return true;
+}
+
+bool rfm69_rudp_afc_set(rudp_context_t *context, rfm69_afc_table_t *table) {
+	if (!rfm69_afc_auto_set(context->rfm, table != NULL)) return false;
+
+	context->afc = table;
+	return true;
+}
 
 struct trx_report_s * rfm69_rudp_report_get(rudp_context_t *context) {
 	return &context->report;
@@ -171,6 +281,11 @@ void rfm69_rudp_report_print(struct trx_report_s *report) {
 	printf("racks_received: %u\n", report->racks_received);
 	printf("rack_requests_sent: %u\n", report->rack_requests_sent);
 	printf("rack_requests_received: %u\n", report->rack_requests_received);
+	printf("fifo_overruns: %u\n", report->fifo_overruns);
+	printf("segment_size: %u\n", report->segment_size);
+	printf("data_baud: %u\n", report->data_baud);
+	printf("rssi: %d\n", report->rssi);
+	printf("rssi_peer: %d\n", report->rssi_peer);
 	printf("return_status: ");
 	switch (report->return_status) {
 		case RUDP_OK:
@@ -205,6 +320,10 @@ bool rfm69_rudp_transmit(rudp_context_t *context, uint8_t address) {
 	uint payload_size = context->payload_size;
 	uint timeout = context->tx_timeout;
 	uint8_t retries = context->tx_retries;
+	uint segment = context->segment_size;
+
+	// AES packets have to fit the FIFO
+	if (rfm->aes_enabled && segment > SEGMENT_MAX_AES) segment = SEGMENT_MAX_AES;
 
     // Cache previous op mode so it can be restored
     // after transmit.
@@ -213,11 +332,20 @@ bool rfm69_rudp_transmit(rudp_context_t *context, uint8_t address) {
 
     rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
 
+    // Tune to where the receiver was heard last, for the whole transfer
+    int32_t afc_offset = rfm->afc_offset;
+    if (context->afc) rfm69_afc_peer_apply(rfm, context->afc, address);
+
 	uint8_t seq_num = get_rand_32() % SEQ_NUM_RAND_LIMIT;
 
-    uint8_t size_bytes[sizeof(payload_size)];
+    // RBT payload: payload size followed by our segment size and, with
+    // adaptive data rate, the fastest BAUD rate we offer
+    uint8_t rbt_payload[sizeof(payload_size) + 2];
     for (int i = 0; i < sizeof(payload_size); i++)
-        size_bytes[i] = (payload_size >> (((sizeof(payload_size) - 1) * 8) - (i * 8))) & 0xFF;
+        rbt_payload[i] = (payload_size >> (((sizeof(payload_size) - 1) * 8) - (i * 8))) & 0xFF;
+    rbt_payload[sizeof(payload_size)] = segment;
+    rbt_payload[sizeof(payload_size) + 1] = context->adapt_cap;
+    uint rbt_payload_size = sizeof rbt_payload - !context->adapt;
 
     // Get our tx_address;
     uint8_t tx_address;
@@ -225,20 +353,22 @@ bool rfm69_rudp_transmit(rudp_context_t *context, uint8_t address) {
 
 	// Build header
 	uint8_t header[HEADER_SIZE];
-	header[HEADER_PACKET_SIZE] = HEADER_EFFECTIVE_SIZE + sizeof(payload_size);
+	header[HEADER_PACKET_SIZE] = HEADER_EFFECTIVE_SIZE + rbt_payload_size;
 	header[HEADER_RX_ADDRESS]  = address;
 	header[HEADER_TX_ADDRESS]  = tx_address;
 	header[HEADER_FLAGS]       = HEADER_FLAG_RBT;
 	header[HEADER_SEQ_NUMBER]  = seq_num;
 	// This count does not include the RBT packet
-	uint8_t num_packets = payload_size/PAYLOAD_MAX;
-    if (payload_size % PAYLOAD_MAX) num_packets++;
+	uint num_packets = payload_size/segment;
+    if (payload_size % segment) num_packets++;
 
 	// zero report struct
 	memset(report, 0x00, (sizeof *report));
 	report->tx_address = tx_address;
 	report->rx_address = address;
 	report->payload_size = payload_size;
+	report->segment_size = segment;
+	report->data_baud = context->baud;
 	report->return_status = RUDP_TIMEOUT;
 
     // This payload is too large and should be fplit into multiple transmissions
@@ -249,7 +379,10 @@ bool rfm69_rudp_transmit(rudp_context_t *context, uint8_t address) {
 
     // Buffer for receiving ACK/RACK
     // Max possible size for ACK/RACK packets
-    uint8_t ack_packet[HEADER_SIZE + num_packets];
+    uint8_t ack_packet[HEADER_SIZE + MAX(num_packets, ACK_ADAPT_SIZE)];
+    // Signal of the ACK, captured while it is still in the FIFO
+    struct rfm69_packet_meta_s ack_meta = {0};
+    bool want_meta = context->adapt || context->afc;
     bool success = false;
     bool ack_received = false;
     for (uint retry = 0; retry <= retries; retry++) {
@@ -264,12 +397,12 @@ bool rfm69_rudp_transmit(rudp_context_t *context, uint8_t address) {
                 HEADER_SIZE
         );
 
-        // Write payload size as payload
+        // Write payload and segment size as payload
         rfm69_write(
                 rfm,
                 RFM69_REG_FIFO,
-                size_bytes,	
-                sizeof(payload_size)
+                rbt_payload,	
+                rbt_payload_size
         );
         
         rfm69_mode_set(rfm, RFM69_OP_MODE_TX);
@@ -282,7 +415,7 @@ bool rfm69_rudp_transmit(rudp_context_t *context, uint8_t address) {
         // with some random deviation to avoid a certain class of timing bugs
         uint next_timeout = timeout + (retry * timeout) + (get_rand_32() % 100);
         // Retry if ACK was not received within timeout
-        if (_rudp_rx_ack(rfm, seq_num + 1, next_timeout) == RUDP_TIMEOUT) continue;
+        if (_rudp_rx_ack(rfm, seq_num + 1, next_timeout, ack_packet, sizeof ack_packet, want_meta ? &ack_meta : NULL) == RUDP_TIMEOUT) continue;
 
         // Ack received
         ack_received = true;
@@ -291,49 +424,61 @@ bool rfm69_rudp_transmit(rudp_context_t *context, uint8_t address) {
     }
     if (!ack_received) goto CLEANUP; // Do not pass go
 
+    // The ACK comes from the receiver's own carrier. Learn it for next
+    // time, retuning now would leave the receiver behind.
+    if (context->afc) {
+        report->afc_hz = rfm69_afc_measure(&ack_meta);
+        rfm69_afc_learn(context->afc, address, rfm->afc_offset, report->afc_hz);
+    }
+
+    // The receiver's pick for the data phase. Anything we did not offer
+    // means it does not do adaptive data rate.
+    uint8_t ack_size = ack_packet[HEADER_PACKET_SIZE] - HEADER_EFFECTIVE_SIZE;
+    if (context->adapt && ack_size >= ACK_ADAPT_SIZE) {
+        rudp_baud_t baud = ack_packet[PAYLOAD_BEGIN];
+
+        report->rssi = ack_meta.rssi;
+        report->rssi_peer = -(int16_t) ack_packet[PAYLOAD_BEGIN + 1];
+
+        if (baud > context->baud && baud <= context->adapt_cap) {
+            rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
+            if (!_rudp_baud_apply(rfm, baud, NULL)) goto CLEANUP;
+            report->data_baud = baud;
+        }
+    }
+
     seq_num += 2; // Set to first data packet seq num
 
     uint8_t seq_num_max = seq_num + num_packets - 1;
 
     uint8_t size;
     uint8_t offset;
-    for (int i = 0; i < num_packets; i++) {
-        rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
 
+    // Each FIFO load kicks off its own TX from STDBY, no mode switches
+    // between data packets
+    rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
+    _rudp_auto_tx(rfm, true);
+    for (int i = 0; i < num_packets; i++) {
         // Not graceful
-        if (seq_num + i == seq_num_max && payload_size % PAYLOAD_MAX)
-            size = payload_size % PAYLOAD_MAX;
+        if (seq_num + i == seq_num_max && payload_size % segment)
+            size = payload_size % segment;
         else
-            size = PAYLOAD_MAX;
+            size = segment;
 
         header[HEADER_PACKET_SIZE] = HEADER_EFFECTIVE_SIZE + size;
         header[HEADER_FLAGS]       = HEADER_FLAG_DATA;
         header[HEADER_SEQ_NUMBER]  = seq_num + i;
 
-        uint offset = PAYLOAD_MAX * i;
+        uint offset = segment * i;
 
-        // Write header to fifo
-        rfm69_write(
-                rfm,
-                RFM69_REG_FIFO,
-                header,	
-                HEADER_SIZE
-        );
-
-        // Write slice of payload
-        rfm69_write(
-                rfm,
-                RFM69_REG_FIFO,
-                &payload[offset],
-                size
-        );
-
-        rfm69_mode_set(rfm, RFM69_OP_MODE_TX);
-        _rudp_block_until_packet_sent(rfm);
+        // Header and slice of payload as one packet
+        rfm69_packet_send(rfm, header, HEADER_SIZE, &payload[offset], size);
 
 		report->bytes_sent += size;
         report->data_packets_sent++;
     }
+    // Received packets fill the FIFO too, which would trigger TX
+    _rudp_auto_tx(rfm, false);
 
     uint8_t message_size = num_packets;
     uint8_t packet_num;
@@ -345,7 +490,7 @@ bool rfm69_rudp_transmit(rudp_context_t *context, uint8_t address) {
         rack_timeout = true;
         while (retries) {
             retries--;
-            if (_rudp_rx_rack(rfm, seq_num_max, timeout, ack_packet) == RUDP_TIMEOUT) {
+            if (_rudp_rx_rack(rfm, seq_num_max, timeout, ack_packet, sizeof ack_packet, NULL) == RUDP_TIMEOUT) {
                 rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
                 
                 header[HEADER_PACKET_SIZE] = HEADER_EFFECTIVE_SIZE; 
@@ -375,45 +520,31 @@ bool rfm69_rudp_transmit(rudp_context_t *context, uint8_t address) {
         report->racks_received++;
 
         message_size = ack_packet[HEADER_PACKET_SIZE] - HEADER_EFFECTIVE_SIZE; 
+        rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
+        _rudp_auto_tx(rfm, true);
         for (int i = 0; i < message_size; i++) {
-            rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
-
             packet_num = ack_packet[PAYLOAD_BEGIN + i]; 
 
+            // Not one of ours
+            if ((uint8_t) (packet_num - seq_num) >= num_packets) continue;
+
             // Not graceful still
-            if (packet_num == seq_num_max && payload_size % PAYLOAD_MAX)
-                size = payload_size % PAYLOAD_MAX;
+            if (packet_num == seq_num_max && payload_size % segment)
+                size = payload_size % segment;
             else
-                size = PAYLOAD_MAX;
+                size = segment;
 
             header[HEADER_PACKET_SIZE] = HEADER_EFFECTIVE_SIZE + size;
             header[HEADER_SEQ_NUMBER]  = packet_num;
 
-            uint offset = PAYLOAD_MAX * (packet_num - seq_num);
-
-            // Write header to fifo
-            rfm69_write(
-                    rfm,
-                    RFM69_REG_FIFO,
-                    header,	
-                    HEADER_SIZE
-            );
-
-            // Write slice of payload
-            rfm69_write(
-                    rfm,
-                    RFM69_REG_FIFO,
-                    &payload[offset],
-                    size
-            );
+            uint offset = segment * (packet_num - seq_num);
 
-            rfm69_mode_set(rfm, RFM69_OP_MODE_TX);
-
-            _rudp_block_until_packet_sent(rfm);
+            rfm69_packet_send(rfm, header, HEADER_SIZE, &payload[offset], size);
 			
 			report->data_packets_retransmitted++;
 			report->data_packets_sent++;
         }
+        _rudp_auto_tx(rfm, false);
     }
 
 	if (is_ok) report->return_status = RUDP_OK;
@@ -421,6 +552,24 @@ bool rfm69_rudp_transmit(rudp_context_t *context, uint8_t address) {
 
     success = true;
 CLEANUP:
+    if (report->data_baud != context->baud) {
+        rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
+        _rudp_baud_apply(rfm, context->baud, NULL);
+    }
+
+    // Offer one rate less after a failed fast transfer, one more after
+    // a confirmed one
+    if (context->adapt) {
+        if (report->return_status == RUDP_OK) {
+            if (context->adapt_cap < context->adapt_max) context->adapt_cap++;
+        }
+        else if (report->data_baud > context->baud) {
+            context->adapt_cap = report->data_baud - 1;
+        }
+    }
+
+    if (context->afc) rfm69_afc_offset_set(rfm, afc_offset);
+
     rfm69_mode_set(rfm, previous_mode);
     return success;
 }
@@ -432,7 +581,7 @@ bool rfm69_rudp_receive(rudp_context_t *context) {
 	struct trx_report_s *report = &context->report;
 	uint8_t *payload = context->buffer;
     uint payload_buffer_size = context->buffer_size;
-	uint per_packet_delay = BAUD_SETTINGS_LOOKUP[context->baud].pp_delay;
+	uint per_packet_delay;
 	uint timeout = context->rx_timeout;
 
     // Cache previous op mode so it can be restored
@@ -444,16 +593,20 @@ bool rfm69_rudp_receive(rudp_context_t *context) {
     rfm69_node_address_get(rfm, &rx_address);
 
     // Max size packet buffer
-    uint8_t packet[RFM69_FIFO_SIZE];
+    uint8_t packet[RFM69_PACKET_MAX];
     // Header buffer
     uint8_t header[HEADER_SIZE];
 
     uint8_t is_rbt;
     uint8_t seq_num;
 
+    // Our own carrier, used while waiting for an RBT and for the ACK
+    int32_t afc_offset = rfm->afc_offset;
+
 	// Zero that report meow
 	memset(report, 0x00, (sizeof *report));
 	report->rx_address = rx_address;
+	report->data_baud = context->baud;
 	report->return_status = RUDP_TIMEOUT;
 
     bool success = false;
@@ -464,53 +617,75 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
                   // start receiving the transmission
     tx_started = false;
 	uint payload_size = 0;
+	uint segment = PAYLOAD_MAX;
 	uint8_t tx_address;
+	int32_t afc_hz = 0;
+	// Signal of the RBT, captured at PayloadReady
+	struct rfm69_packet_meta_s rbt_meta = {0};
+	struct rfm69_packet_meta_s *want_meta = context->adapt || context->afc ? &rbt_meta : NULL;
+
+    // Back from a data phase tuned to the last transmitter
+    if (context->afc) rfm69_afc_offset_set(rfm, afc_offset);
+
+    // Back from a data phase at another BAUD rate
+    if (report->data_baud != context->baud) {
+        rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
+        _rudp_baud_apply(rfm, context->baud, NULL);
+    }
+	report->data_baud = context->baud;
+
     for (;;) {
         if (get_absolute_time() >= timeout_time) break;
 
-        rfm69_mode_set(rfm, RFM69_OP_MODE_RX);
-
-        if (!_rudp_is_payload_ready(rfm)) {
-            sleep_us(1);
-            continue;
+        if (context->rx_listen) {
+            if (!_rudp_listen_receive(rfm, packet, timeout_time, want_meta)) continue;
         }
+        // Whole packet, however large, so nothing is left in the FIFO
+        else if (!_rudp_packet_receive(rfm, packet, timeout_time, report, want_meta)) continue;
+
+        if (context->afc) afc_hz = rfm69_afc_measure(&rbt_meta);
 		
         rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
 
-        rfm69_read(
-                rfm,
-                RFM69_REG_FIFO,
-                packet,
-                HEADER_SIZE
-        );
-
         is_rbt = packet[HEADER_FLAGS] & HEADER_FLAG_RBT;
+        if (!is_rbt) continue;
 
-        if (!is_rbt) {
-            // Empty the FIFO
-            rfm69_read(
-                    rfm,
-                    RFM69_REG_FIFO,
-                    packet,
-                    packet[HEADER_PACKET_SIZE] - HEADER_EFFECTIVE_SIZE
-            );
-            continue;
-        } 
+        uint message_size = packet[HEADER_PACKET_SIZE] - HEADER_EFFECTIVE_SIZE;
+        if (message_size < sizeof(payload_size)) continue;
 
 		report->rbt_received++;
 
         // Read expected payload size
-        uint8_t size_bytes[sizeof(payload_size)];
-        rfm69_read(
-                rfm,
-                RFM69_REG_FIFO,
-                size_bytes,
-                sizeof(payload_size) 
-        );
-
+        uint8_t *size_bytes = &packet[PAYLOAD_BEGIN];
         for (int i = 0; i < sizeof(payload_size); i++) 
             payload_size |= size_bytes[i] << (((sizeof(payload_size) - 1) * 8) - (i * 8));
 
+        // Segment size follows. Older transmitters leave it out and
+        // always send PAYLOAD_MAX.
+        if (message_size > sizeof(payload_size))
+            segment = size_bytes[sizeof(payload_size)];
+        if (segment < 1 || segment > SEGMENT_MAX) segment = PAYLOAD_MAX;
+
+        // Refuse what we cannot take before it is ACKed. The data loop
+        // indexes packets_received and payload by these.
+        if (payload_size > payload_buffer_size) {
+            report->return_status = RUDP_BUFFER_OVERFLOW;
+            goto CLEANUP;
+        }
+        if ((payload_size + segment - 1) / segment > TX_PACKETS_MAX) {
+            report->return_status = RUDP_PAYLOAD_OVERFLOW;
+            goto CLEANUP;
+        }
+
+        // Then the fastest BAUD rate the transmitter offers, if it does
+        // adaptive data rate
+        bool adapt = context->adapt && message_size > sizeof(payload_size) + 1;
+        rudp_baud_t data_baud = context->baud;
+        if (adapt) {
+            rudp_baud_t offer = size_bytes[sizeof(payload_size) + 1];
+            if (offer > context->adapt_max) offer = context->adapt_max;
+            data_baud = _rudp_adapt_select(context->baud, offer, rbt_meta.rssi);
+        }
 
         // Get the sender's node address
         tx_address = packet[HEADER_TX_ADDRESS];
@@ -520,7 +695,7 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
         seq_num = packet[HEADER_SEQ_NUMBER] + 1;
 
         // Build ACK packet header
-        header[HEADER_PACKET_SIZE] = HEADER_EFFECTIVE_SIZE;
+        header[HEADER_PACKET_SIZE] = HEADER_EFFECTIVE_SIZE + (adapt ? ACK_ADAPT_SIZE : 0);
         header[HEADER_RX_ADDRESS]  = tx_address;
         header[HEADER_TX_ADDRESS]  = rx_address;
         header[HEADER_FLAGS]       = HEADER_FLAG_RBT | HEADER_FLAG_ACK;
@@ -533,11 +708,33 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
                 HEADER_SIZE
         );
 
+        if (adapt) {
+            uint8_t ack_payload[ACK_ADAPT_SIZE] = {data_baud, -rbt_meta.rssi};
+            rfm69_write(
+                    rfm,
+                    RFM69_REG_FIFO,
+                    ack_payload,
+                    ACK_ADAPT_SIZE
+            );
+        }
+
         rfm69_mode_set(rfm, RFM69_OP_MODE_TX);
         _rudp_block_until_packet_sent(rfm);
 
+        if (data_baud != context->baud) {
+            rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
+            _rudp_baud_apply(rfm, data_baud, NULL);
+        }
+
+        // The transmitter stays on this carrier until it is done
+        if (context->afc) rfm69_afc_offset_set(rfm, afc_offset + afc_hz);
+
 		report->payload_size = payload_size;
+		report->segment_size = segment;
 		report->tx_address = tx_address;
+		report->data_baud = data_baud;
+		report->rssi = rbt_meta.rssi;
+		report->afc_hz = afc_hz;
 		report->acks_sent++;
 
         tx_started = true;
@@ -548,8 +745,11 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
     if (!tx_started) goto CLEANUP;
 
 
-	uint8_t num_packets_expected = payload_size/PAYLOAD_MAX;
-    if (payload_size % PAYLOAD_MAX) num_packets_expected++;
+	uint8_t num_packets_expected = payload_size/segment;
+    if (payload_size % segment) num_packets_expected++;
+
+    // Time each data packet is expected to take, full segment or not
+    per_packet_delay = _rudp_packet_time_us(report->data_baud, HEADER_SIZE + segment);
 
     // We have our first data packet waiting in the FIFO now
     // Set our data packet seq num bounds
@@ -561,6 +761,9 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
 
     uint payload_bytes_received = 0; 
 
+    if (context->rx_meta)
+        memset(context->rx_meta, 0x00, context->rx_meta_count * sizeof *context->rx_meta);
+
     uint8_t is_data;
     uint8_t packet_num;
     uint8_t is_req_rack;
@@ -572,6 +775,11 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
         if (now >= timeout_time) goto CLEANUP;
 
         if (now >= rack_timeout) {
+            // Nothing at the faster rate. The transmitter may have missed
+            // our ACK and still be sending RBTs at the handshake rate.
+            if (report->data_baud != context->baud && payload_bytes_received == 0)
+                goto RESTART_RBT_LOOP;
+
             rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
             // Time to send a RACK
             uint8_t size = (num_packets_missing > PAYLOAD_MAX) ? PAYLOAD_MAX : num_packets_missing;
@@ -580,9 +788,6 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
             header[HEADER_FLAGS] = HEADER_FLAG_RACK;
             header[HEADER_SEQ_NUMBER] = seq_num_max;
 
-            bool state;
-            rfm69_irq2_flag_state(rfm, RFM69_IRQ2_FLAG_FIFO_NOT_EMPTY, &state);
-
             rfm69_write( 
                     rfm,
                     RFM69_REG_FIFO,
@@ -618,25 +823,13 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
         // Make sure packet is sent before leaving TX
         rfm69_mode_set(rfm, RFM69_OP_MODE_RX);
         
-        if (!_rudp_is_payload_ready(rfm)) {
-            sleep_us(1);
-            continue;
-        }
-
-        rfm69_read(
-                rfm,
-                RFM69_REG_FIFO,
-                packet,
-                HEADER_SIZE
-        );
+        // Sleep until a packet arrives or it is time to send a RACK
+        absolute_time_t wake_time = rack_timeout < timeout_time ? rack_timeout : timeout_time;
+        struct rfm69_packet_meta_s meta;
+        bool want_meta = context->rx_meta != NULL;
+        if (!_rudp_packet_receive(rfm, packet, wake_time, report, want_meta ? &meta : NULL)) continue;
 
         uint message_size = packet[HEADER_PACKET_SIZE] - HEADER_EFFECTIVE_SIZE;
-        rfm69_read(
-            rfm,
-            RFM69_REG_FIFO,
-            &packet[PAYLOAD_BEGIN],
-            message_size
-        );
 
 
         if (tx_address != packet[HEADER_TX_ADDRESS]) continue;
@@ -645,7 +838,7 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
         if (is_rbt) goto RESTART_RBT_LOOP;
 
         is_data = packet[HEADER_FLAGS] & HEADER_FLAG_DATA;
-        if (!is_data) continue;
+        if (!is_data || message_size > segment) continue;
 
         packet_num = packet[HEADER_SEQ_NUMBER];
         if (packet_num < seq_num || packet_num > seq_num_max) continue;
@@ -658,12 +851,19 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
             continue;
         }
 
+        // Where it goes. Nothing may land past the announced size.
+        uint payload_offset = segment * (packet_num - seq_num);
+        if (payload_offset + message_size > payload_size) continue;
+
         // Account for packet only if it is a new packet
         if (packets_received[packet_num - seq_num]) continue;
         packets_received[packet_num - seq_num] = true;
 
         num_packets_missing--;
 
+        if (want_meta && (uint) (packet_num - seq_num) < context->rx_meta_count)
+            context->rx_meta[packet_num - seq_num] = meta;
+
         payload_bytes_received += message_size;
 
 		report->data_packets_received++;
@@ -676,7 +876,6 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
 
 
         // Copy the payload data into the payload buffer
-        uint payload_offset = PAYLOAD_MAX * (packet_num - seq_num);
         for (int i = 0; i < message_size; i++) {
             payload[payload_offset + i] = packet[PAYLOAD_BEGIN + i];    
         }
@@ -702,6 +901,12 @@ RESTART_RBT_LOOP: // This is to return to the RBT loop in case of a false
     success = true;
 
 CLEANUP:
+    if (report->data_baud != context->baud) {
+        rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
+        _rudp_baud_apply(rfm, context->baud, NULL);
+    }
+    if (context->afc) rfm69_afc_offset_set(rfm, afc_offset);
+
     rfm69_mode_set(rfm, previous_mode);
     return success;
 }
@@ -710,38 +915,21 @@ static RUDP_RETURN _rudp_rx_rack(
         rfm69_context_t *rfm,
         uint8_t seq_num,
         uint timeout,
-        uint8_t *packet
+        uint8_t *packet,
+        size_t size,
+        struct rfm69_packet_meta_s *meta
 )
 {
     RUDP_RETURN rval = RUDP_TIMEOUT;
-    uint8_t is_rack;
+    bool is_rack;
     bool is_seq;
-    uint8_t is_ok;
 
-    rfm69_mode_set(rfm, RFM69_OP_MODE_RX);
+    // A RACK has to fit the FIFO
+    _rudp_rx_timeout_arm(rfm, timeout, HEADER_EFFECTIVE_SIZE + PAYLOAD_MAX);
 
     absolute_time_t timeout_time = make_timeout_time_ms(timeout);
     for (;;) {
-        if (get_absolute_time() > timeout_time) break;
-
-        if (!_rudp_is_payload_ready(rfm)) {
-            continue;
-        }
-
-        rfm69_read(
-                rfm,
-                RFM69_REG_FIFO,
-                packet,
-                HEADER_SIZE
-        );
-
-        uint8_t message_size = packet[HEADER_PACKET_SIZE] - HEADER_EFFECTIVE_SIZE; 
-        rfm69_read(
-                rfm,
-                RFM69_REG_FIFO,
-                &packet[PAYLOAD_BEGIN],
-                message_size 
-        );
+        if (_rudp_rx_reply(rfm, packet, size, timeout_time, meta) != RUDP_OK) break;
 
         // This is a RACK packet, which is what we wanted
         is_rack = (packet[HEADER_FLAGS] & HEADER_FLAG_RACK);
@@ -753,38 +941,31 @@ static RUDP_RETURN _rudp_rx_rack(
         rval = RUDP_OK; 
         break;
     }
+
+    rfm69_rx_timeout_set(rfm, 0, 0);
     return rval;
 }
 
 static RUDP_RETURN _rudp_rx_ack(
         rfm69_context_t *rfm,
         uint8_t seq_num,
-        uint timeout
+        uint timeout,
+        uint8_t *packet,
+        size_t size,
+        struct rfm69_packet_meta_s *meta
 )
 {
     RUDP_RETURN rval = RUDP_TIMEOUT;
-    uint8_t packet[HEADER_SIZE];
-    bool state;
     bool is_ack;
     bool is_seq;
 
-    rfm69_mode_set(rfm, RFM69_OP_MODE_RX);
+    _rudp_rx_timeout_arm(rfm, timeout, HEADER_EFFECTIVE_SIZE + ACK_ADAPT_SIZE);
 
     absolute_time_t timeout_time = make_timeout_time_ms(timeout);
     for (;;) {
-        if (get_absolute_time() > timeout_time) break;
-
-        if (!_rudp_is_payload_ready(rfm)) {
-            continue;
-        }
-        // No need to check length byte, an ack packet is only a header
-        // with some flags set
-        rfm69_read(
-                rfm,
-                RFM69_REG_FIFO,
-                packet,
-                HEADER_SIZE
-        );
+        // An ack packet is a header with some flags set, plus the
+        // adaptive data rate payload if the receiver does it
+        if (_rudp_rx_reply(rfm, packet, size, timeout_time, meta) != RUDP_OK) break;
 
         // This is an RBT/ACK packet, which is what we wanted
         is_ack = (packet[HEADER_FLAGS] & (HEADER_FLAG_ACK | HEADER_FLAG_RBT)) > 0;
@@ -796,19 +977,204 @@ static RUDP_RETURN _rudp_rx_ack(
         rval = RUDP_OK; 
         break;
     }
+
+    rfm69_rx_timeout_set(rfm, 0, 0);
     return rval;
 }
 
-static inline bool _rudp_is_payload_ready(rfm69_context_t *rfm) {
-    bool state;
-    rfm69_irq2_flag_state(rfm, RFM69_IRQ2_FLAG_PAYLOAD_READY, &state);
-    return state;
+static RUDP_RETURN _rudp_rx_reply(
+        rfm69_context_t *rfm,
+        uint8_t *packet,
+        size_t size,
+        absolute_time_t deadline,
+        struct rfm69_packet_meta_s *meta
+)
+{
+    uint8_t buf[RFM69_PACKET_MAX];
+    size_t len;
+
+    // FifoLevel says a packet too long for the FIFO is on its way
+    rfm69_write_masked(rfm, RFM69_REG_FIFO_THRESH, RFM69_STREAM_FIFO_THRESH, 0x7F);
+    rfm69_mode_set(rfm, RFM69_OP_MODE_RX);
+
+    for (;;) {
+        if (_rudp_wait_reply(rfm, deadline, meta != NULL) != RUDP_OK) return RUDP_TIMEOUT;
+
+        // It has started, so this only waits for the rest of it. Drained
+        // whole either way, the FIFO is never left half read.
+        int64_t remaining = absolute_time_diff_us(get_absolute_time(), deadline);
+        bool received = meta
+            ? rfm69_packet_receive_meta(rfm, buf, sizeof buf, &len, MAX(remaining, 1), meta)
+            : rfm69_packet_receive(rfm, buf, sizeof buf, &len, MAX(remaining, 1));
+        if (!received) continue;
+        if (len < HEADER_SIZE) continue;
+
+        // Whatever does not fit the caller's buffer is cut off
+        if (len > size) len = size;
+        memcpy(packet, buf, len);
+        packet[HEADER_PACKET_SIZE] = len - 1;
+
+        return RUDP_OK;
+    }
 }
 
-static inline void _rudp_block_until_packet_sent(rfm69_context_t *rfm) {
+static void _rudp_rx_timeout_arm(rfm69_context_t *rfm, uint timeout, uint size) {
+    uint16_t bitrate;
+    if (!rfm69_bitrate_get(rfm, &bitrate) || bitrate == 0) return;
+
+    // One unit is 16 bit periods, RegBitrate / 2 us. Waits too long for
+    // the register are left to the MCU deadline alone.
+    uint64_t start = ((uint64_t) timeout * 1000 * 2 + bitrate - 1) / bitrate;
+    if (start > 0xFF) start = 0;
+
+    // Once something is heard the whole packet has to follow, with a
+    // unit of slack for RSSI detection
+    uint bits = (RUDP_AIRTIME_PREAMBLE + RUDP_AIRTIME_SYNC + 1 + size + RUDP_AIRTIME_CRC) * 8;
+    uint payload = (bits + 15) / 16 + 1;
+
+    rfm69_rx_timeout_set(rfm, start, payload);
+}
+
+static RUDP_RETURN _rudp_wait_reply(rfm69_context_t *rfm, absolute_time_t deadline, bool fei) {
+    for (;;) {
+        int64_t remaining = absolute_time_diff_us(get_absolute_time(), deadline);
+        if (remaining <= 0) return RUDP_TIMEOUT;
+
+        // Start FEI at SyncAddress. With DIO3 wired the wait wakes for
+        // it, otherwise look for it between short waits.
+        uint32_t slice = remaining;
+        uint32_t events = RFM69_EVENT_PAYLOAD_READY | RFM69_EVENT_FIFO_LEVEL | RFM69_EVENT_TIMEOUT;
+        if (fei && !rfm->fei_started) {
+            rfm69_irq_flags_t flags;
+            if (!rfm69_irq_flags_get(rfm, &flags) || !_packet_fei_poll(rfm, &flags)) return RUDP_TIMEOUT;
+            if (!rfm->fei_started) {
+                if (rfm->pin_dio[3] != RFM69_PIN_UNUSED) events |= RFM69_EVENT_SYNC_ADDRESS;
+                else slice = MIN(remaining, RUDP_FEI_POLL_US);
+            }
+        }
+
+        uint32_t occurred;
+        bool event = rfm69_event_wait_any(rfm, events, slice, &occurred);
+        if (!event && slice < remaining) continue;
+        if (!event) return RUDP_TIMEOUT;
+        if (occurred & (RFM69_EVENT_PAYLOAD_READY | RFM69_EVENT_FIFO_LEVEL)) return RUDP_OK;
+        // SyncAddress, FEI is started on the next pass
+        if (!(occurred & RFM69_EVENT_TIMEOUT)) continue;
+
+        // Nothing started within RegRxTimeout1: nothing is coming
+        rfm69_irq_flags_t flags;
+        if (!rfm69_irq_flags_get(rfm, &flags)) return RUDP_TIMEOUT;
+        if (!rfm69_irq1_flag_test(&flags, RFM69_IRQ1_FLAG_RSSI)) return RUDP_TIMEOUT;
+
+        // Noise crossed the RSSI threshold. Leaving RX clears the flags
+        // and rearms both timeouts.
+        rfm69_mode_set(rfm, RFM69_OP_MODE_STDBY);
+        rfm69_mode_set(rfm, RFM69_OP_MODE_RX);
+    }
+}
+
+static inline bool _rudp_wait_payload_ready(rfm69_context_t *rfm, absolute_time_t deadline) {
     bool state = false;
-    while (!state) {
-        rfm69_irq2_flag_state(rfm, RFM69_IRQ2_FLAG_PACKET_SENT, &state);
-        sleep_us(1);
+
+    int64_t remaining = absolute_time_diff_us(get_absolute_time(), deadline);
+    if (remaining <= 0) {
+        rfm69_event_check(rfm, RFM69_EVENT_PAYLOAD_READY, &state);
+        return state;
     }
+
+    return rfm69_event_wait(rfm, RFM69_EVENT_PAYLOAD_READY, remaining);
+}
+
+static bool _rudp_listen_receive(
+        rfm69_context_t *rfm,
+        uint8_t *packet,
+        absolute_time_t deadline,
+        struct rfm69_packet_meta_s *meta
+)
+{
+    uint64_t start_us = time_us_64();
+    int64_t remaining = absolute_time_diff_us(get_absolute_time(), deadline);
+    if (remaining <= 0) return false;
+
+    if (!rfm69_listen_start(rfm)) return false;
+    bool received = rfm69_listen_wait(rfm, remaining);
+
+    // RSSI and AFC while the RX window that got the packet is still open.
+    // There is no FEI here, Listen Mode is never polled for sync.
+    if (received && meta) {
+        rfm69_irq_flags_t flags;
+        received = rfm69_irq_flags_get(rfm, &flags) && _packet_meta_capture(rfm, &flags, start_us, meta);
+    }
+
+    // Back to standby either way. The packet survives in the FIFO.
+    if (!rfm69_listen_stop(rfm, RFM69_OP_MODE_STDBY) || !received) return false;
+
+    if (!rfm69_read(rfm, RFM69_REG_FIFO, packet, 1)) return false;
+
+    // Too short for a header or too long to have arrived whole. Drop
+    // it by clearing the FIFO.
+    if (packet[HEADER_PACKET_SIZE] < HEADER_EFFECTIVE_SIZE 
+            || packet[HEADER_PACKET_SIZE] >= RFM69_FIFO_SIZE) 
+    {
+        uint8_t overrun = RFM69_IRQ2_FLAG_FIFO_OVERRUN;
+        rfm69_write(rfm, RFM69_REG_IRQ_FLAGS_2, &overrun, 1);
+        return false;
+    }
+
+    return rfm69_read(rfm, RFM69_REG_FIFO, &packet[1], packet[HEADER_PACKET_SIZE]);
+}
+
+static bool _rudp_packet_receive(
+        rfm69_context_t *rfm,
+        uint8_t *packet,
+        absolute_time_t deadline,
+        struct trx_report_s *report,
+        struct rfm69_packet_meta_s *meta
+)
+{
+    int64_t remaining = absolute_time_diff_us(get_absolute_time(), deadline);
+    if (remaining <= 0) return false;
+
+    size_t len;
+    bool received = meta
+        ? rfm69_packet_receive_meta(rfm, packet, RFM69_PACKET_MAX, &len, remaining, meta)
+        : rfm69_packet_receive(rfm, packet, RFM69_PACKET_MAX, &len, remaining);
+    if (received) return len > HEADER_EFFECTIVE_SIZE;
+
+    if (rfm->return_status == RFM69_FIFO_OVERRUN) report->fifo_overruns++;
+    return false;
+}
+
+static inline void _rudp_block_until_packet_sent(rfm69_context_t *rfm) {
+    rfm69_event_wait(rfm, RFM69_EVENT_PACKET_SENT, 0);
+}
+
+static inline void _rudp_auto_tx(rfm69_context_t *rfm, bool enabled) {
+    if (enabled)
+        rfm69_auto_modes_set(
+                rfm,
+                RFM69_AUTO_ENTER_FIFO_NOT_EMPTY,
+                RFM69_AUTO_EXIT_PACKET_SENT,
+                RFM69_AUTO_INTERMEDIATE_TX
+        );
+    else
+        rfm69_auto_modes_clear(rfm);
+}
+
+static uint _rudp_packet_time_us(rudp_baud_t baud, uint size) {
+    uint bytes = RUDP_AIRTIME_PREAMBLE + RUDP_AIRTIME_SYNC + size + RUDP_AIRTIME_CRC;
+    uint64_t bits_us = (uint64_t) bytes * 8 * 1000000;
+    uint bitrate = BAUD_SETTINGS_LOOKUP[baud].bitrate;
+
+    return (bits_us + bitrate - 1) / bitrate + RUDP_PACKET_GAP_US;
+}
+
+static rudp_baud_t _rudp_adapt_select(rudp_baud_t base, rudp_baud_t max, int16_t rssi) {
+    rudp_baud_t baud = base;
+
+    for (rudp_baud_t b = base + 1; b <= max && b < RUDP_BAUD_NUM; b++) {
+        if (rssi >= BAUD_SETTINGS_LOOKUP[b].sensitivity + RUDP_ADAPT_MARGIN_DB) baud = b;
+    }
+
+    return baud;
 }
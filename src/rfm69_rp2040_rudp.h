@@ -22,6 +22,8 @@
 #define RFM69_PICO_RUDP_H
 
 #include "rfm69_rp2040_interface.h"
+#include "rfm69_rp2040_config.h"
+#include "wtp-1_0.h"
 
 typedef enum _RUDP_RETURN {
     RUDP_OK,
@@ -33,10 +35,47 @@ typedef enum _RUDP_RETURN {
 
 // BAUD rates available to user of library
 typedef enum RUDP_BAUD {
-	RUDP_BAUD_57_6,
+	RUDP_BAUD_1_2,
+	RUDP_BAUD_2_4,
+	RUDP_BAUD_4_8,
+	RUDP_BAUD_9_6,
+	RUDP_BAUD_19_2,
+	RUDP_BAUD_38_4,
+	RUDP_BAUD_57_6, // Default
+	RUDP_BAUD_76_8,
+	RUDP_BAUD_115_2,
+	RUDP_BAUD_153_6,
+	RUDP_BAUD_200,
+	RUDP_BAUD_250,
+	RUDP_BAUD_300,
 	RUDP_BAUD_NUM
 } rudp_baud_t;
 
+// Airtime model used for per-packet timing. Every packet carries the
+// preamble and sync word rfm69_init sets up plus a CRC on top of the
+// header and payload.
+#define RUDP_AIRTIME_PREAMBLE 3
+#define RUDP_AIRTIME_SYNC     3
+#define RUDP_AIRTIME_CRC      2
+
+// How often a reply wait that needs FEI looks for SyncAddress when DIO3
+// is not wired
+#ifndef RUDP_FEI_POLL_US
+#define RUDP_FEI_POLL_US 50
+#endif
+
+// Added to each packet's airtime to cover TX startup and the sender's
+// FIFO loading between packets.
+#ifndef RUDP_PACKET_GAP_US
+#define RUDP_PACKET_GAP_US 1500
+#endif
+
+// Adaptive data rate: a BAUD rate is picked for the data phase if the RBT
+// came in at least this far above its sensitivity.
+#ifndef RUDP_ADAPT_MARGIN_DB
+#define RUDP_ADAPT_MARGIN_DB 15
+#endif
+
 
 enum HEADER {
     HEADER_PACKET_SIZE,
@@ -62,6 +101,12 @@ struct trx_report_s {
 	uint racks_received;
 	uint rack_requests_sent;
 	uint rack_requests_received;
+	uint fifo_overruns;
+	uint segment_size;
+	rudp_baud_t data_baud; // BAUD rate of the data phase
+	int16_t rssi;          // dBm of the peer's RBT/ACK, 0 if not measured
+	int16_t rssi_peer;     // dBm the peer measured for ours, 0 if unknown
+	int32_t afc_hz;        // Peer's carrier offset measured this transfer
 	RUDP_RETURN return_status;
 	uint8_t tx_address;
 	uint8_t rx_address;
@@ -78,16 +123,30 @@ typedef struct rudp_context_ {
 	uint rx_timeout;
 	uint8_t tx_retries;
 	rudp_baud_t baud;
+	uint8_t segment_size; // Payload bytes per data packet sent
+	bool rx_listen;       // Wait for RBT in Listen Mode
+	bool adapt;           // Negotiate the data phase BAUD rate
+	rudp_baud_t adapt_max; // Fastest BAUD rate allowed
+	rudp_baud_t adapt_cap; // Fastest BAUD rate offered, lowered on failures
+	struct rfm69_packet_meta_s *rx_meta; // Per data packet receive metadata
+	uint rx_meta_count;
+	rfm69_afc_table_t *afc; // Learned carrier offsets per peer
 } rudp_context_t;
 
 
 #define PAYLOAD_BEGIN (HEADER_SIZE)
 #define HEADER_EFFECTIVE_SIZE (HEADER_SIZE - 1) // HEADER_SIZE - length byte (it isn't part of its own count)
 #define PAYLOAD_MAX (65 - HEADER_EFFECTIVE_SIZE)
+// Largest data segment, with the packet streamed through the FIFO
+#define SEGMENT_MAX (RFM69_PACKET_MAX - 1 - HEADER_EFFECTIVE_SIZE)
+// Largest data segment with hardware AES, which cannot stream
+#define SEGMENT_MAX_AES (WTP_PKT_SIZE_MAX_AES - HEADER_EFFECTIVE_SIZE)
+// ACK payload with adaptive data rate: BAUD rate and -RSSI of the RBT
+#define ACK_ADAPT_SIZE 2
 #define SEQ_NUM_RAND_LIMIT 25 
 // 256 (byte packet num max) - potential range for starting seq num - 1 ack packet
 #define TX_PACKETS_MAX (256 - SEQ_NUM_RAND_LIMIT - 1) 
-// Max bytes that can be sent in one transmission
+// Max bytes that can be sent in one transmission at the default segment size
 #define TX_PAYLOAD_MAX (TX_PACKETS_MAX * PAYLOAD_MAX)
 
 enum FLAG {
@@ -108,8 +167,9 @@ enum FLAG {
 // Rfm69 should be initialized before being passed to RUDP
 bool rfm69_rudp_init(rudp_context_t *context, rfm69_context_t *rfm);
 
-// Set transmission BAUD rate
+// Set transmission BAUD rate (1.2 -> 300 kbps, 57.6 kbps by default)
 // RX and TX must have same BAUD settings
+// Retransmit request timing follows from the airtime at this rate.
 bool rfm69_rudp_baud_set(rudp_context_t *context, rudp_baud_t baud);
 
 // RX/TX timeout settings
@@ -135,11 +195,65 @@ bool rfm69_rudp_payload_set(
 
 bool rfm69_rudp_address_set(rudp_context_t *context, uint8_t address);
 
+// Payload bytes carried by each data packet we send (1 -> SEGMENT_MAX).
+// Defaults to PAYLOAD_MAX, which fits the FIFO. Larger segments are
+// streamed and cut per-packet overhead; the receiver learns the size
+// from the RBT packet, so only the transmitter needs to set it.
+// While hardware AES is on, transmit clamps it to SEGMENT_MAX_AES.
+bool rfm69_rudp_segment_size_set(rudp_context_t *context, uint size);
+uint rfm69_rudp_segment_size_get(const rudp_context_t *context);
+
+// Makes rfm69_rudp_receive wait for the RBT in Listen Mode instead of
+// continuous RX, with the radio duty cycling per <config>. Once the RBT
+// arrives the rest of the transfer runs in normal RX. <config>'s end
+// criteria is overridden. Pass NULL to go back to continuous RX.
+//
+// The transmitter's RBT retries (tx_timeout/tx_retries) must span at
+// least one idle period or the RBT can fall between RX windows.
+bool rfm69_rudp_rx_listen_set(
+		rudp_context_t *context,
+		const struct rfm69_listen_config_s *config
+);
+
+// Lets the data phase of a transfer run faster than the BAUD rate set with
+// rfm69_rudp_baud_set, which stays in use for the RBT/ACK handshake.
+// The receiver measures the RSSI of the RBT and picks the fastest rate
+// up to <max> (and up to the transmitter's own limit) with
+// RUDP_ADAPT_MARGIN_DB to spare. The ACK carries the choice and the
+// RSSI back. Both ends go back to the handshake rate afterwards.
+//
+// Has to be enabled on both ends, otherwise the handshake rate is used.
+// A transmitter whose fast transfer fails offers one step less next
+// time, and steps back up after each success.
+bool rfm69_rudp_adapt_set(rudp_context_t *context, bool enabled, rudp_baud_t max);
+
+// Makes rfm69_rudp_receive record receive metadata (RSSI, FEI, timestamp,
+// CRC) for each data packet in <meta>, indexed by packet number within
+// the transfer (payload offset / segment size). Packets beyond <count>
+// are not recorded. Pass NULL to stop.
+void rfm69_rudp_rx_meta_set(
+		rudp_context_t *context,
+		struct rfm69_packet_meta_s *meta,
+		uint count
+);
+
+// Corrects for the crystal offset between us and each peer, using AFC
+// (turned on here) and <table> to remember the offsets.
+// The transmitter tunes to the receiver's learned carrier for the whole
+// transfer and refines the estimate from each ACK, which the receiver
+// always sends untuned. The receiver measures the RBT and tunes to the
+// transmitter for the data phase. Both ends go back to their own carrier
+// afterwards. Pass NULL to turn it off again.
+bool rfm69_rudp_afc_set(rudp_context_t *context, rfm69_afc_table_t *table);
+
 // Returns a copy of last TRX report struct
 struct trx_report_s * rfm69_rudp_report_get(rudp_context_t *context);
 void rfm69_rudp_report_print(struct trx_report_s *report);
 
-// Attempts to send payload to provided radio address
+// Attempts to send payload to provided radio address. Blocks for the
+// whole transfer, as does rfm69_rudp_receive. For a transfer that runs
+// from a poll loop use WTP (rfm69_rp2040_wtp.h), see
+// docs/rudp_interface.md for moving over.
 bool rfm69_rudp_transmit(rudp_context_t *context, uint8_t address);
 
 static inline void _rudp_block_until_packet_sent(rfm69_context_t *rfm);
@@ -147,22 +261,86 @@ static inline void _rudp_block_until_packet_sent(rfm69_context_t *rfm);
 bool rfm69_rudp_receive(rudp_context_t *context);
 
 
-// Internal ack rx logic
+// Internal ack rx logic. <packet> holds <size> bytes. Fills <meta>
+// unless NULL.
 static RUDP_RETURN _rudp_rx_ack(
         rfm69_context_t *rfm,
         uint8_t seq_num,
-        uint timeout
+        uint timeout,
+        uint8_t *packet,
+        size_t size,
+        struct rfm69_packet_meta_s *meta
 );
 
-// Internal rack rx logic
+// Internal rack rx logic. <packet> holds <size> bytes. Fills <meta>
+// unless NULL.
 static RUDP_RETURN _rudp_rx_rack(
         rfm69_context_t *rfm,
         uint8_t seq_num,
         uint timeout,
-        uint8_t *header
+        uint8_t *packet,
+        size_t size,
+        struct rfm69_packet_meta_s *meta
+);
+
+// Internal receive of the next reply before <deadline>. Packets of any
+// length are received whole and cut down to the <size> bytes <packet>
+// holds, with the length byte fixed up to match. Fills <meta> at
+// PayloadReady unless NULL.
+static RUDP_RETURN _rudp_rx_reply(
+        rfm69_context_t *rfm,
+        uint8_t *packet,
+        size_t size,
+        absolute_time_t deadline,
+        struct rfm69_packet_meta_s *meta
+);
+
+// Internal RX timeouts for a reply wait of <timeout> ms: the radio flags
+// Timeout if nothing is heard in time, or if a <size> byte packet (header
+// and payload) does not follow once something is.
+static void _rudp_rx_timeout_arm(rfm69_context_t *rfm, uint timeout, uint size);
+
+// Internal wait for an ACK/RACK until <deadline>. RUDP_TIMEOUT once the
+// deadline passes or the radio's RX timeout says nothing is coming.
+// RUDP_OK once a packet is arriving (PayloadReady or FifoLevel).
+// Sleeps on DIO0/DIO1/DIO4 if all are wired. With <fei> it also starts
+// FEI at SyncAddress, on DIO3 if wired and otherwise polled every
+// RUDP_FEI_POLL_US.
+static RUDP_RETURN _rudp_wait_reply(rfm69_context_t *rfm, absolute_time_t deadline, bool fei);
+
+// Internal block on payload ready until <deadline>.
+// Sleeps on DIO0 if wired, polls the IRQ flags otherwise.
+static inline bool _rudp_wait_payload_ready(rfm69_context_t *rfm, absolute_time_t deadline);
+
+// Internal Listen Mode receive of an RBT sized packet before <deadline>.
+// Fills <meta> (without FEI) unless NULL.
+static bool _rudp_listen_receive(
+        rfm69_context_t *rfm,
+        uint8_t *packet,
+        absolute_time_t deadline,
+        struct rfm69_packet_meta_s *meta
+);
+
+// Internal receive of a whole (possibly streamed) packet before <deadline>.
+// Counts FIFO overruns in <report>. Fills <meta> unless NULL.
+static bool _rudp_packet_receive(
+        rfm69_context_t *rfm,
+        uint8_t *packet,
+        absolute_time_t deadline,
+        struct trx_report_s *report,
+        struct rfm69_packet_meta_s *meta
 );
 
-// Internal polling block on payload ready flag
-static inline bool _rudp_is_payload_ready(rfm69_context_t *rfm);
+// Internal airtime of a <size> byte packet (length byte, header and
+// payload) at <baud>, plus RUDP_PACKET_GAP_US.
+static uint _rudp_packet_time_us(rudp_baud_t baud, uint size);
+
+// Internal BAUD rate for the data phase: the fastest from <base> up to
+// <max> that <rssi> clears with RUDP_ADAPT_MARGIN_DB to spare.
+static rudp_baud_t _rudp_adapt_select(rudp_baud_t base, rudp_baud_t max, int16_t rssi);
+
+// Internal AutoModes toggle for data bursts. While on, every FIFO load
+// is sent from STDBY without mode switches.
+static inline void _rudp_auto_tx(rfm69_context_t *rfm, bool enabled);
 
 #endif // RFM60_PICO_RUDP_H
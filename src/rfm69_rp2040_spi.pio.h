@@ -0,0 +1,47 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// --------- //
+// rfm69_spi //
+// --------- //
+
+#define rfm69_spi_wrap_target 0
+#define rfm69_spi_wrap 10
+
+static const uint16_t rfm69_spi_program_instructions[] = {
+            //     .wrap_target
+    0x90a0, //  0: pull   block           side 0     
+    0xa047, //  1: mov    y, osr                     
+    0xe000, //  2: set    pins, 0                    
+    0x80a0, //  3: pull   block                      
+    0xe027, //  4: set    x, 7                       
+    0x7101, //  5: out    pins, 1         side 0 [1] 
+    0x5801, //  6: in     pins, 1         side 1     
+    0x1845, //  7: jmp    x--, 5          side 1     
+    0x9020, //  8: push   block           side 0     
+    0x0083, //  9: jmp    y--, 3                     
+    0xe001, // 10: set    pins, 1                    
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program rfm69_spi_program = {
+    .instructions = rfm69_spi_program_instructions,
+    .length = 11,
+    .origin = -1,
+};
+
+static inline pio_sm_config rfm69_spi_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + rfm69_spi_wrap_target, offset + rfm69_spi_wrap);
+    sm_config_set_sideset(&c, 2, true, false);
+    return c;
+}
+#endif
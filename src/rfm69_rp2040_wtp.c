@@ -0,0 +1,902 @@
+// rfm69_rp2040_wtp.c
+// WTP 1.0 transfer engine
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <string.h>
+
+#include "rfm69_rp2040_wtp.h"
+#include "pico/rand.h"
+
+// Header fields are big endian
+static void _wtp_u32_put(uint8_t *dst, uint32_t value) {
+	dst[0] = value >> 24;
+	dst[1] = value >> 16;
+	dst[2] = value >> 8;
+	dst[3] = value;
+}
+
+static uint32_t _wtp_u32_get(const uint8_t *src) {
+	return (uint32_t) src[0] << 24
+		| (uint32_t) src[1] << 16
+		| (uint32_t) src[2] << 8
+		| src[3];
+}
+
+bool rfm69_wtp_init(wtp_context_t *context, rfm69_context_t *rfm) {
+	context->rfm = rfm;
+
+	context->buffer = NULL;
+	context->buffer_size = 0;
+	context->payload = NULL;
+	context->payload_size = 0;
+
+	context->timeout = 0;
+	context->rx_timeout = 30000;
+	context->retries = 5;
+	context->window = 32;
+	context->segment_size = WTP_SEGMENT_DEFAULT;
+
+	context->state = WTP_STATE_IDLE;
+	context->callback = NULL;
+	context->callback_arg = NULL;
+
+	context->session_timeout = 0;
+	context->session = false;
+
+	context->read = NULL;
+	context->write = NULL;
+	context->stream_buffer = NULL;
+	context->stream_buffer_size = 0;
+
+	memset(&context->report, 0x00, sizeof context->report);
+
+	struct rfm69_radio_config_s config = {
+		.fields = RFM69_CONFIG_DCFREE
+			| RFM69_CONFIG_PACKET_FORMAT
+			| RFM69_CONFIG_PAYLOAD_LENGTH,
+		.dcfree = RFM69_DCFREE_WHITENING,
+		.packet_format = RFM69_PACKET_VARIABLE,
+		// Only a maximum in variable length mode
+		.payload_length = RFM69_PACKET_MAX - 1,
+	};
+	if (!rfm69_config_apply(rfm, &config)) return false;
+
+	rfm69_mode_set(rfm, RFM69_OP_MODE_SLEEP);
+	return true;
+}
+
+bool rfm69_wtp_timeout_set(wtp_context_t *context, uint timeout) {
+	context->timeout = timeout;
+	return true;
+}
+
+bool rfm69_wtp_rx_timeout_set(wtp_context_t *context, uint timeout) {
+	context->rx_timeout = timeout;
+	return true;
+}
+
+bool rfm69_wtp_retries_set(wtp_context_t *context, uint8_t retries) {
+	context->retries = retries;
+	return true;
+}
+
+bool rfm69_wtp_window_set(wtp_context_t *context, uint window) {
+	if (window < 1 || window > WTP_WINDOW_MAX) return false;
+
+	context->window = window;
+	return true;
+}
+
+bool rfm69_wtp_segment_size_set(wtp_context_t *context, uint size) {
+	if (size < 1 || size > WTP_PKT_DATA_MAX) return false;
+
+	context->segment_size = size;
+	return true;
+}
+
+bool rfm69_wtp_payload_set(wtp_context_t *context, const void *payload, uint payload_size) {
+	context->payload = payload;
+	context->payload_size = payload_size;
+	return true;
+}
+
+bool rfm69_wtp_rx_buffer_set(wtp_context_t *context, void *buffer, uint buffer_size) {
+	context->buffer = buffer;
+	context->buffer_size = buffer_size;
+	return true;
+}
+
+bool rfm69_wtp_source_set(
+		wtp_context_t *context,
+		wtp_read_t read,
+		void *arg,
+		void *buffer,
+		uint buffer_size)
+{
+	context->read = read;
+	context->read_arg = arg;
+	context->stream_buffer = buffer;
+	context->stream_buffer_size = buffer_size;
+	return true;
+}
+
+bool rfm69_wtp_sink_set(
+		wtp_context_t *context,
+		wtp_write_t write,
+		void *arg,
+		void *buffer,
+		uint buffer_size)
+{
+	context->write = write;
+	context->write_arg = arg;
+	context->stream_buffer = buffer;
+	context->stream_buffer_size = buffer_size;
+	return true;
+}
+
+bool rfm69_wtp_session_set(wtp_context_t *context, uint timeout) {
+	context->session_timeout = timeout;
+	context->session = false;
+	return true;
+}
+
+void rfm69_wtp_session_close(wtp_context_t *context) {
+	context->session = false;
+}
+
+void rfm69_wtp_callback_set(wtp_context_t *context, wtp_callback_t callback, void *arg) {
+	context->callback = callback;
+	context->callback_arg = arg;
+}
+
+struct wtp_report_s * rfm69_wtp_report_get(wtp_context_t *context) {
+	return &context->report;
+}
+
+// Sends one packet: header with <flags>, <seq> and <ack>, then <size>
+// bytes of <data>.
+static bool _wtp_send(
+		rfm69_context_t *rfm,
+		uint8_t rx_address,
+		uint8_t tx_address,
+		uint8_t flags,
+		uint32_t seq,
+		uint32_t ack,
+		const uint8_t *data,
+		uint size)
+{
+	uint8_t header[WTP_HEADER_SIZE];
+	header[WTP_HEADER_PKT_SIZE_OFFSET] = WTP_HEADER_SIZE - 1 + size;
+	header[WTP_HEADER_RX_ADDR_OFFSET]  = rx_address;
+	header[WTP_HEADER_TX_ADDR_OFFSET]  = tx_address;
+	header[WTP_HEADER_FLAGS_OFFSET]    = flags;
+	_wtp_u32_put(&header[WTP_HEADER_SEQ_NUM_OFFSET], seq);
+	_wtp_u32_put(&header[WTP_HEADER_ACK_NUM_OFFSET], ack);
+
+	return rfm69_packet_send(rfm, header, WTP_HEADER_SIZE, data, size);
+}
+
+// Takes the packet that is coming in, if any, when it is for <self> (or
+// broadcast) from <peer> (anyone if WTP_BROADCAST_ADDRESS). Does not wait
+// for one to start. <len> includes the length byte.
+static bool _wtp_receive_poll(
+		rfm69_context_t *rfm,
+		uint8_t *packet,
+		size_t *len,
+		uint8_t self,
+		uint8_t peer)
+{
+	// A 1 us timeout only checks whether a packet has started
+	if (!rfm69_packet_receive(rfm, packet, RFM69_PACKET_MAX, len, 1)) return false;
+
+	if (*len < WTP_HEADER_SIZE) return false;
+	uint8_t rx_address = packet[WTP_HEADER_RX_ADDR_OFFSET];
+	if (rx_address != self && rx_address != WTP_BROADCAST_ADDRESS) return false;
+	if (peer != WTP_BROADCAST_ADDRESS && packet[WTP_HEADER_TX_ADDR_OFFSET] != peer) return false;
+
+	return true;
+}
+
+// Puts the radio in RX set up the way rfm69_packet_receive streams
+static bool _wtp_listen(rfm69_context_t *rfm) {
+	if (!rfm69_write_masked(rfm, RFM69_REG_FIFO_THRESH, RFM69_STREAM_FIFO_THRESH, 0x7F))
+		return false;
+	return rfm69_mode_set(rfm, RFM69_OP_MODE_RX);
+}
+
+static inline bool _wtp_map_test(const uint8_t *map, uint32_t index) {
+	index %= _WTP_MAP_BITS;
+	return map[index / 8] & (1u << (index % 8));
+}
+
+static inline void _wtp_map_set(uint8_t *map, uint32_t index) {
+	index %= _WTP_MAP_BITS;
+	map[index / 8] |= 1u << (index % 8);
+}
+
+static inline void _wtp_map_clear(uint8_t *map, uint32_t index) {
+	index %= _WTP_MAP_BITS;
+	map[index / 8] &= ~(1u << (index % 8));
+}
+
+static bool _wtp_session_alive(wtp_context_t *context) {
+	return context->session_timeout && context->session && !time_reached(context->session_expires);
+}
+
+// Carries the session on past a finished transfer. A receiver that heard
+// nothing keeps the session as it was, a failed transfer drops it. So
+// does a lone SYN|FIN: it is shorter than the segment size, which both
+// ends would have to agree on.
+static void _wtp_session_update(wtp_context_t *context, WTP_RETURN status) {
+	if (!context->session_timeout || context->state == WTP_STATE_RX_LISTEN) return;
+	// Nothing to carry on, broadcasts are not acknowledged
+	if (context->broadcast) return;
+
+	bool tx = context->state == WTP_STATE_TX_BURST || context->state == WTP_STATE_TX_ACK_WAIT;
+	bool sized = context->resumed || (tx ? context->segments > 1 : context->fin_index > 0);
+
+	if (status != WTP_OK || !sized) {
+		context->session = false;
+		return;
+	}
+
+	context->session = true;
+	context->session_peer = context->peer;
+	context->session_segment = context->report.segment_size;
+	context->session_isn = context->isn;
+	context->session_seq = context->isn + (tx ? context->segments : context->fin_index + 1);
+	context->session_expires = make_timeout_time_ms(context->session_timeout);
+}
+
+// Ends the transfer with <status> and hands it to the callback
+static void _wtp_finish(wtp_context_t *context, WTP_RETURN status) {
+	_wtp_session_update(context, status);
+
+	context->report.return_status = status;
+	context->state = WTP_STATE_IDLE;
+
+	rfm69_mode_set(context->rfm, context->previous_mode);
+
+	if (context->callback) context->callback(context, context->callback_arg);
+}
+
+// Sends a cumulative ACK for everything before <base>, with a SACK bitmap
+// of what came in after it.
+static bool _wtp_sack_send(wtp_context_t *context, uint8_t flags) {
+	uint32_t base = context->base;
+	uint8_t sack[WTP_SACK_SIZE_MAX] = {0};
+	uint sack_size = 0;
+
+	for (uint32_t i = base + 1; i < context->end && i - (base + 1) < WTP_WINDOW_MAX; i++) {
+		if (!_wtp_map_test(context->map, i)) continue;
+
+		uint bit = i - (base + 1);
+		sack[bit / 8] |= 1u << (bit % 8);
+		sack_size = bit / 8 + 1;
+	}
+
+	context->report.acks_sent++;
+	return _wtp_send(
+			context->rfm,
+			context->peer,
+			context->report.rx_address,
+			flags,
+			context->isn,
+			context->isn + base,
+			sack,
+			sack_size
+	);
+}
+
+// Picks the segments of the next burst: every hole the last ACK showed
+// plus what is new in the window. After a timeout only the first hole,
+// to get an ACK back. <base> itself is never SACKed, so there is always
+// one.
+static void _wtp_tx_plan(wtp_context_t *context) {
+	uint32_t base = context->base;
+
+	// Broadcasts go out once, in one burst, with no ACK to wait for
+	if (context->broadcast) {
+		context->cursor = 0;
+		context->last = context->segments - 1;
+		context->state = WTP_STATE_TX_BURST;
+		return;
+	}
+
+	// The SYN goes out on its own until the receiver has answered
+	bool syn = base == 0 && !context->resumed;
+	// A source can only keep as many segments around as it has slots
+	uint window = context->read ? MIN(context->window, context->slots) : context->window;
+	uint32_t end = syn ? 1 : MIN(base + window, context->segments);
+	uint32_t last = base;
+
+	if (!context->probe) {
+		for (uint32_t i = end; i-- > base;) {
+			if (!_wtp_map_test(context->map, i)) {
+				last = i;
+				break;
+			}
+		}
+	}
+
+	context->cursor = base;
+	context->last = last;
+	context->state = WTP_STATE_TX_BURST;
+}
+
+// Finds segment <i>'s data. A streamed segment is pulled from the source
+// the first time it goes out and kept in its slot until it has been
+// acknowledged. A short read is the end of the stream.
+static bool _wtp_tx_data(wtp_context_t *context, uint32_t i, const uint8_t **data, uint *size) {
+	uint segment = context->report.segment_size;
+
+	if (!context->read) {
+		uint offset = i * segment;
+		*data = &context->payload[offset];
+		*size = MIN(segment, context->payload_size - offset);
+		return true;
+	}
+
+	uint8_t *slot = &context->stream_buffer[(i % context->slots) * segment];
+	*data = slot;
+
+	if (i < context->sent) {
+		*size = i == context->segments - 1 ? context->fin_size : segment;
+		return true;
+	}
+
+	int n = context->read(context->read_arg, slot, segment);
+	if (n < 0) return false;
+	*size = n;
+
+	if ((uint) n < segment) {
+		context->segments = i + 1;
+		context->fin_size = n;
+		// The burst ends here, RTR included
+		if (context->last > i) context->last = i;
+		context->report.payload_size = i * segment + n;
+	}
+
+	return true;
+}
+
+// Sends the next segment of the burst. The last one asks for an ACK.
+static void _wtp_tx_burst(wtp_context_t *context) {
+	struct wtp_report_s *report = &context->report;
+
+	while (_wtp_map_test(context->map, context->cursor)) context->cursor++;
+	uint32_t i = context->cursor++;
+
+	const uint8_t *data;
+	uint size;
+	if (!_wtp_tx_data(context, i, &data, &size)) {
+		_wtp_finish(context, WTP_STREAM_ERROR);
+		return;
+	}
+
+	uint8_t flags = WTP_FLAG_SEG;
+	if (i == 0 && !context->resumed) flags |= WTP_FLAG_SYN;
+	if (i == context->segments - 1) flags |= WTP_FLAG_FIN;
+	if (i == context->last && !context->broadcast) flags |= WTP_FLAG_RTR;
+
+	if (!_wtp_send(context->rfm, context->peer, report->tx_address, flags, context->isn + i, 0, data, size)) {
+		_wtp_finish(context, WTP_TIMEOUT);
+		return;
+	}
+
+	report->segments_sent++;
+	if (i < context->sent) report->segments_retransmitted++;
+	else report->bytes_sent += size;
+
+	if (i == context->last && context->broadcast) {
+		_wtp_finish(context, WTP_OK);
+		return;
+	}
+
+	if (i == context->last) {
+		context->sent = MAX(context->sent, i + 1);
+		context->deadline = make_timeout_time_ms(context->ack_timeout);
+		context->state = WTP_STATE_TX_ACK_WAIT;
+		_wtp_listen(context->rfm);
+	}
+}
+
+// ACK wait in ms for <segment> byte segments at the current bitrate,
+// unless one was set. Mirrors what the receiver works out from the SYN.
+static uint _wtp_ack_timeout(wtp_context_t *context, uint segment) {
+	if (context->timeout) return context->timeout;
+
+	uint32_t data_us, ack_us;
+	if (!rfm69_airtime_us(context->rfm, WTP_HEADER_SIZE + segment, &data_us)
+			|| !rfm69_airtime_us(context->rfm, WTP_HEADER_SIZE + WTP_SACK_SIZE_MAX, &ack_us))
+	{
+		return 100;
+	}
+
+	return (data_us + ack_us + 999) / 1000 + WTP_TIMEOUT_SLACK_MS;
+}
+
+// Picks the ISN, in the session if there is one to the same peer, and
+// plans the first burst. Falling back to a SYN goes through here again.
+// What was sent stays, a source's slots still hold it.
+static void _wtp_tx_begin(wtp_context_t *context) {
+	context->resumed = _wtp_session_alive(context)
+		&& !context->broadcast
+		&& context->session_peer == context->peer
+		&& context->session_segment == context->report.segment_size;
+
+	context->isn = context->resumed ? context->session_seq : get_rand_32();
+	context->base = 0;
+	context->probe = false;
+	memset(context->map, 0x00, sizeof context->map);
+
+	_wtp_tx_plan(context);
+}
+
+// Takes in an ACK, or gives the burst up once the ACK timeout passes
+static void _wtp_tx_ack_wait(wtp_context_t *context) {
+	struct wtp_report_s *report = &context->report;
+	uint32_t isn = context->isn;
+	uint8_t packet[RFM69_PACKET_MAX];
+	size_t len;
+
+	if (!_wtp_receive_poll(context->rfm, packet, &len, report->tx_address, context->peer)) {
+		if (!time_reached(context->deadline)) return;
+
+		// Nothing back without a SYN, the receiver may have dropped the
+		// session. Start over with one.
+		if (context->resumed && report->acks_received == 0) {
+			context->session = false;
+			_wtp_tx_begin(context);
+			return;
+		}
+
+		context->probe = true;
+		if (++context->retry > context->retries) _wtp_finish(context, WTP_TIMEOUT);
+		else _wtp_tx_plan(context);
+		return;
+	}
+
+	// ACKs echo the ISN as their seq, and are never broadcast
+	if (packet[WTP_HEADER_RX_ADDR_OFFSET] == WTP_BROADCAST_ADDRESS) return;
+	if (!(packet[WTP_HEADER_FLAGS_OFFSET] & WTP_FLAG_ACK)) return;
+	if (_wtp_u32_get(&packet[WTP_HEADER_SEQ_NUM_OFFSET]) != isn) return;
+
+	uint32_t acked = _wtp_u32_get(&packet[WTP_HEADER_ACK_NUM_OFFSET]) - isn;
+	if (acked > context->segments) return;
+
+	report->acks_received++;
+
+	// The receiver gave up on the rest
+	if ((packet[WTP_HEADER_FLAGS_OFFSET] & WTP_FLAG_FIN) && acked < context->segments) {
+		_wtp_finish(context, WTP_RESET);
+		return;
+	}
+
+	bool progress = acked > context->base;
+	for (; context->base < acked; context->base++) _wtp_map_clear(context->map, context->base);
+
+	// Bit n of the SACK is segment acked + 1 + n
+	const uint8_t *sack = &packet[WTP_DATA_SEGMENT_OFFSET];
+	uint sack_bits = (len - WTP_HEADER_SIZE) * 8;
+	for (uint bit = 0; bit < sack_bits; bit++) {
+		uint32_t i = acked + 1 + bit;
+		if (i >= context->sent) break;
+
+		if ((sack[bit / 8] & (1u << (bit % 8))) && !_wtp_map_test(context->map, i)) {
+			_wtp_map_set(context->map, i);
+			progress = true;
+		}
+	}
+
+	if (context->base >= context->segments) {
+		_wtp_finish(context, WTP_OK);
+		return;
+	}
+
+	if (progress) context->retry = 0;
+	else if (++context->retry > context->retries) {
+		_wtp_finish(context, WTP_TIMEOUT);
+		return;
+	}
+
+	context->probe = false;
+	_wtp_tx_plan(context);
+}
+
+bool rfm69_wtp_tx_start(wtp_context_t *context, uint8_t address) {
+	if (context->state != WTP_STATE_IDLE) return false;
+
+	rfm69_context_t *rfm = context->rfm;
+	struct wtp_report_s *report = &context->report;
+	uint payload_size = context->payload_size;
+	uint segment = context->segment_size;
+
+	// AES packets have to fit the FIFO
+	if (rfm->aes_enabled && segment > WTP_PKT_DATA_MAX_AES) segment = WTP_PKT_DATA_MAX_AES;
+
+	if (context->read) {
+		context->slots = context->stream_buffer_size / segment;
+		if (context->slots == 0) return false;
+	}
+
+	rfm69_mode_get(rfm, &context->previous_mode);
+
+	memset(report, 0x00, sizeof *report);
+	rfm69_node_address_get(rfm, &report->tx_address);
+	report->rx_address = address;
+	report->payload_size = payload_size;
+	report->segment_size = segment;
+	report->return_status = WTP_TIMEOUT;
+
+	// An empty payload still takes one (empty) SYN|FIN segment. Streams
+	// only find out at the end.
+	context->segments = payload_size / segment;
+	if (payload_size % segment || payload_size == 0) context->segments++;
+	if (context->read) {
+		context->segments = UINT32_MAX;
+		report->payload_size = 0;
+	}
+
+	context->peer = address;
+	context->broadcast = address == WTP_BROADCAST_ADDRESS;
+	context->ack_timeout = _wtp_ack_timeout(context, segment);
+	context->sent = 0;
+	context->retry = 0;
+	_wtp_tx_begin(context);
+	return true;
+}
+
+// Tells the transmitter to stop at the first gap with a FIN|ACK and ends
+// the transfer with <status>
+static void _wtp_rx_reset(wtp_context_t *context, WTP_RETURN status) {
+	if (context->broadcast) {
+		_wtp_finish(context, status);
+		return;
+	}
+
+	_wtp_send(
+			context->rfm,
+			context->peer,
+			context->report.rx_address,
+			WTP_FLAG_ACK | WTP_FLAG_FIN,
+			context->isn,
+			context->isn + context->base,
+			NULL,
+			0
+	);
+	context->report.acks_sent++;
+	_wtp_finish(context, status);
+}
+
+// Hands segment <i> from its slot to the sink
+static bool _wtp_rx_deliver(wtp_context_t *context, uint32_t i) {
+	uint segment = context->report.segment_size;
+	uint size = context->fin_seen && i == context->fin_index ? context->fin_size : segment;
+
+	// An empty transfer's FIN
+	if (size == 0) return true;
+
+	const uint8_t *slot = &context->stream_buffer[(i % context->slots) * segment];
+	return context->write(context->write_arg, slot, size) >= 0;
+}
+
+// Takes in one data segment and answers it if it asks for an ACK. False
+// if it is not part of this transfer.
+static bool _wtp_rx_segment(wtp_context_t *context, const uint8_t *packet, size_t len) {
+	struct wtp_report_s *report = &context->report;
+	uint segment = report->segment_size;
+
+	uint8_t flags = packet[WTP_HEADER_FLAGS_OFFSET];
+	if (!(flags & WTP_FLAG_SEG)) return false;
+	if ((packet[WTP_HEADER_RX_ADDR_OFFSET] == WTP_BROADCAST_ADDRESS) != context->broadcast) return false;
+
+	uint32_t index = _wtp_u32_get(&packet[WTP_HEADER_SEQ_NUM_OFFSET]) - context->isn;
+	uint size = len - WTP_HEADER_SIZE;
+
+	// Not from this transfer
+	if (size > segment || (index > 0 && (flags & WTP_FLAG_SYN))) return false;
+	// Slots only hold a short segment at the end
+	if (context->write && size < segment && !(flags & WTP_FLAG_FIN)) return false;
+
+	// Past any window a transmitter can have
+	if (index >= context->end && index - context->base >= WTP_WINDOW_MAX) return false;
+
+	report->segments_received++;
+
+	if (context->write && context->slots == 0) {
+		_wtp_rx_reset(context, WTP_BUFFER_OVERFLOW);
+		return true;
+	}
+
+	// Anything new within the window, in any order. A sink's window is
+	// as many segments as its buffer has slots.
+	uint32_t base = context->base;
+	uint window = context->write ? MIN(WTP_WINDOW_MAX, context->slots) : WTP_WINDOW_MAX;
+	bool in_window = index >= base && index - base < window;
+	if (in_window && !context->fin && !_wtp_map_test(context->map, index)) {
+		const uint8_t *data = &packet[WTP_DATA_SEGMENT_OFFSET];
+
+		if (context->write) {
+			memcpy(&context->stream_buffer[(index % context->slots) * segment], data, size);
+		}
+		else {
+			uint64_t offset = (uint64_t) index * segment;
+
+			// Out of room: tell the transmitter to stop at the first gap
+			if (offset + size > context->buffer_size) {
+				_wtp_rx_reset(context, WTP_BUFFER_OVERFLOW);
+				return true;
+			}
+
+			memcpy(&context->buffer[offset], data, size);
+		}
+		report->bytes_received += size;
+
+		_wtp_map_set(context->map, index);
+		if (index >= context->end) context->end = index + 1;
+
+		if (flags & WTP_FLAG_FIN) {
+			context->fin_index = index;
+			context->fin_size = size;
+			context->fin_seen = true;
+		}
+
+		// Slide past everything that is now in order, handing it to the
+		// sink on the way
+		while (_wtp_map_test(context->map, context->base)) {
+			if (context->write && !_wtp_rx_deliver(context, context->base)) {
+				_wtp_rx_reset(context, WTP_STREAM_ERROR);
+				return true;
+			}
+			_wtp_map_clear(context->map, context->base++);
+		}
+
+		context->fin = context->fin_seen && context->base > context->fin_index;
+	}
+
+	if ((flags & WTP_FLAG_RTR) && !context->broadcast) {
+		uint8_t reply = WTP_FLAG_ACK;
+		if (flags & WTP_FLAG_SYN) reply |= WTP_FLAG_SYN;
+		if (context->fin) reply |= WTP_FLAG_FIN;
+
+		_wtp_sack_send(context, reply);
+		_wtp_listen(context->rfm);
+	}
+
+	// In a session the next rfm69_wtp_rx_start answers for this transfer,
+	// no need to hang around. Nor for a broadcast, nobody wants an answer.
+	if (context->fin && (context->session_timeout || context->broadcast)) {
+		report->payload_size = report->bytes_received;
+		_wtp_finish(context, WTP_OK);
+	}
+
+	return true;
+}
+
+// Restarts the wait for the transmitter's next packet
+static void _wtp_rx_idle_arm(wtp_context_t *context) {
+	if (context->state != WTP_STATE_RX_DATA) return;
+
+	// Quiet for this long means the transmitter has given up
+	uint idle = context->fin ? 2 * context->ack_timeout : context->ack_timeout * (context->retries + 2);
+	context->deadline = make_timeout_time_ms(idle);
+}
+
+static void _wtp_rx_begin(wtp_context_t *context, uint8_t peer, bool broadcast, uint32_t isn, uint segment) {
+	context->peer = peer;
+	context->broadcast = broadcast;
+	context->resumed = false;
+	context->isn = isn;
+	context->base = 0;
+	context->end = 0;
+	context->fin_seen = false;
+	context->fin = false;
+	memset(context->map, 0x00, sizeof context->map);
+
+	context->report.tx_address = peer;
+	context->report.segment_size = segment;
+	context->ack_timeout = _wtp_ack_timeout(context, segment);
+
+	// An empty SYN|FIN has nothing to hold, it needs no room
+	if (context->write) context->slots = segment ? context->stream_buffer_size / segment : 1;
+
+	context->state = WTP_STATE_RX_DATA;
+}
+
+// Waits for a SYN from anyone, or in a session for the peer's next
+// transfer, which starts right where the last one ended
+static void _wtp_rx_listen(wtp_context_t *context) {
+	struct wtp_report_s *report = &context->report;
+	uint8_t packet[RFM69_PACKET_MAX];
+	size_t len;
+
+	if (!_wtp_receive_poll(context->rfm, packet, &len, report->rx_address, WTP_BROADCAST_ADDRESS)) {
+		if (time_reached(context->deadline)) _wtp_finish(context, WTP_TIMEOUT);
+		return;
+	}
+
+	uint8_t flags = packet[WTP_HEADER_FLAGS_OFFSET];
+	uint8_t peer = packet[WTP_HEADER_TX_ADDR_OFFSET];
+	uint32_t seq = _wtp_u32_get(&packet[WTP_HEADER_SEQ_NUM_OFFSET]);
+	bool broadcast = packet[WTP_HEADER_RX_ADDR_OFFSET] == WTP_BROADCAST_ADDRESS;
+
+	if (!(flags & WTP_FLAG_SEG)) return;
+	// Only a transfer with nothing in it has an empty SYN
+	if ((flags & WTP_FLAG_SYN) && len == WTP_HEADER_SIZE && !(flags & WTP_FLAG_FIN)) return;
+
+	// Every segment but the last is as long as the SYN's
+	if (flags & WTP_FLAG_SYN)
+		_wtp_rx_begin(context, peer, broadcast, seq, len - WTP_HEADER_SIZE);
+	else if (!broadcast && _wtp_session_alive(context) && peer == context->session_peer) {
+		uint32_t session_seq = context->session_seq;
+		uint32_t session_isn = context->session_isn;
+
+		if (seq - session_seq < WTP_WINDOW_MAX) {
+			_wtp_rx_begin(context, peer, false, session_seq, context->session_segment);
+			context->resumed = true;
+		}
+		// The last transfer's FIN|ACK got lost
+		else if (seq - session_isn < session_seq - session_isn) {
+			if (flags & WTP_FLAG_RTR) {
+				_wtp_send(
+						context->rfm,
+						peer,
+						report->rx_address,
+						WTP_FLAG_ACK | WTP_FLAG_FIN,
+						session_isn,
+						session_seq,
+						NULL,
+						0
+				);
+				_wtp_listen(context->rfm);
+			}
+			return;
+		}
+		else return;
+	}
+	else return;
+
+	_wtp_rx_segment(context, packet, len);
+	_wtp_rx_idle_arm(context);
+}
+
+// Takes in segments until the transmitter has gone quiet. Once done it
+// stays around long enough to answer again in case the FIN|ACK got lost.
+static void _wtp_rx_data(wtp_context_t *context) {
+	struct wtp_report_s *report = &context->report;
+	uint8_t packet[RFM69_PACKET_MAX];
+	size_t len;
+
+	if (!_wtp_receive_poll(context->rfm, packet, &len, report->rx_address, context->peer)) {
+		if (!time_reached(context->deadline)) return;
+
+		if (context->fin) {
+			report->payload_size = report->bytes_received;
+			_wtp_finish(context, WTP_OK);
+		}
+		else _wtp_finish(context, WTP_TIMEOUT);
+		return;
+	}
+
+	uint8_t flags = packet[WTP_HEADER_FLAGS_OFFSET];
+	uint32_t seq = _wtp_u32_get(&packet[WTP_HEADER_SEQ_NUM_OFFSET]);
+	bool syn = (flags & WTP_FLAG_SEG) && (flags & WTP_FLAG_SYN) && seq != context->isn
+		&& (len > WTP_HEADER_SIZE || (flags & WTP_FLAG_FIN));
+
+	// The transmitter got our FIN|ACK and has moved on to a new transfer.
+	// Leave its SYN to the next rfm69_wtp_rx_start.
+	if (context->fin && syn) {
+		report->payload_size = report->bytes_received;
+		_wtp_finish(context, WTP_OK);
+		return;
+	}
+
+	// A resumed transfer that we could not take anything of, and the
+	// transmitter has fallen back to a SYN. Start over with it.
+	if (syn && context->end == 0) {
+		bool broadcast = packet[WTP_HEADER_RX_ADDR_OFFSET] == WTP_BROADCAST_ADDRESS;
+		_wtp_rx_begin(context, context->peer, broadcast, seq, len - WTP_HEADER_SIZE);
+		_wtp_rx_segment(context, packet, len);
+		_wtp_rx_idle_arm(context);
+		return;
+	}
+
+	// Only this transfer's packets keep it alive
+	if (_wtp_rx_segment(context, packet, len)) _wtp_rx_idle_arm(context);
+}
+
+bool rfm69_wtp_rx_start(wtp_context_t *context) {
+	if (context->state != WTP_STATE_IDLE) return false;
+
+	rfm69_context_t *rfm = context->rfm;
+	struct wtp_report_s *report = &context->report;
+
+	rfm69_mode_get(rfm, &context->previous_mode);
+
+	memset(report, 0x00, sizeof *report);
+	rfm69_node_address_get(rfm, &report->rx_address);
+	report->return_status = WTP_TIMEOUT;
+
+	if (!_wtp_listen(rfm)) {
+		rfm69_mode_set(rfm, context->previous_mode);
+		return false;
+	}
+
+	context->deadline = make_timeout_time_ms(context->rx_timeout);
+	context->state = WTP_STATE_RX_LISTEN;
+	return true;
+}
+
+bool rfm69_wtp_poll(wtp_context_t *context) {
+	switch (context->state) {
+		case WTP_STATE_TX_BURST:
+			_wtp_tx_burst(context);
+			break;
+		case WTP_STATE_TX_ACK_WAIT:
+			_wtp_tx_ack_wait(context);
+			break;
+		case WTP_STATE_RX_LISTEN:
+			_wtp_rx_listen(context);
+			break;
+		case WTP_STATE_RX_DATA:
+			_wtp_rx_data(context);
+			break;
+		default:
+			break;
+	}
+
+	return context->state != WTP_STATE_IDLE;
+}
+
+void rfm69_wtp_abort(wtp_context_t *context) {
+	if (context->state == WTP_STATE_IDLE) return;
+	_wtp_finish(context, WTP_TIMEOUT);
+}
+
+// Sleeps until a packet starts coming in or the current deadline passes.
+// Returns right away while there are segments to send.
+static void _wtp_sleep(wtp_context_t *context) {
+	if (context->state == WTP_STATE_TX_BURST) return;
+
+	int64_t remaining = absolute_time_diff_us(get_absolute_time(), context->deadline);
+	if (remaining <= 0) return;
+
+	uint32_t occurred;
+	rfm69_event_wait_any(
+			context->rfm,
+			RFM69_EVENT_PAYLOAD_READY | RFM69_EVENT_FIFO_LEVEL,
+			MIN(remaining, UINT32_MAX),
+			&occurred
+	);
+}
+
+bool rfm69_wtp_transmit(wtp_context_t *context, uint8_t address) {
+	if (!rfm69_wtp_tx_start(context, address)) return false;
+	while (rfm69_wtp_poll(context)) _wtp_sleep(context);
+
+	return context->report.return_status == WTP_OK;
+}
+
+bool rfm69_wtp_receive(wtp_context_t *context) {
+	if (!rfm69_wtp_rx_start(context)) return false;
+	while (rfm69_wtp_poll(context)) _wtp_sleep(context);
+
+	return context->report.return_status == WTP_OK;
+}
@@ -0,0 +1,321 @@
+// rfm69_rp2040_wtp.h
+// WTP 1.0 transfer engine
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// WTP moves one payload from a transmitter to a receiver as numbered
+// segments. Sequence numbers count segments from a random initial one
+// (ISN) in the 4 byte header fields, so transfers are not capped by the
+// sequence space the way RUDP's 8 bit one is.
+//
+//   TX                                  RX
+//   SYN|SEG|RTR  seq=ISN   + data ->
+//                                 <-  SYN|ACK  ack=ISN+1
+//   SEG          seq=ISN+1 + data ->
+//   ...
+//   SEG|RTR      seq=ISN+k + data ->
+//                                 <-  ACK      ack=first missing + SACK
+//   ...
+//   SEG|FIN|RTR  seq=last  + data ->
+//                                 <-  FIN|ACK  ack=last+1
+//
+// The SYN carries the first segment, so the handshake costs no extra
+// round trip, and its data length sets the segment size for the rest
+// of the transfer. FIN rides on the last segment. The transmitter keeps
+// a window of up to <window> segments past the first unacknowledged one
+// and asks for an ACK (RTR) on the last one of each burst.
+//
+// ACKs are selective. The ack field is the first segment missing, and the
+// payload is a bitmap of what arrived after it: bit n (LSB first) of
+// byte n / 8 is segment ack + 1 + n. WTP_SACK_SIZE_MAX bytes cover the
+// largest window. The receiver keeps segments that arrive out of order,
+// so the next burst only carries the holes and whatever is new. After a
+// timeout only the first hole goes out, as a probe for a fresh ACK. A
+// receiver that cannot take the rest ends the transfer early with
+// FIN|ACK.
+//
+// Transfers run as a state machine that rfm69_wtp_poll advances. A poll
+// does at most one packet's worth of work (sends one segment, or takes
+// in the packet that is arriving) and returns, so the caller can start a
+// transfer with rfm69_wtp_tx_start/rfm69_wtp_rx_start and keep polling
+// it from its main loop. rfm69_wtp_transmit and rfm69_wtp_receive do
+// the same and sleep between packets.
+//
+//   rfm69_wtp_callback_set(&wtp, on_done, NULL);
+//   rfm69_wtp_tx_start(&wtp, 0x02);
+//   for (;;) {
+//       rfm69_wtp_poll(&wtp);
+//       sensors_sample();
+//       tud_task();
+//   }
+//
+// Sessions (opt in with rfm69_wtp_session_set) carry the peer, sequence
+// numbers and segment size from one successful transfer to the next until
+// they sit idle for the session timeout. The next transfer to the same
+// peer picks up at the sequence number after the last FIN and leaves out
+// the SYN, so its first burst opens the whole window right away. A
+// resumed transfer that gets no ACK at all falls back to a SYN, which
+// the receiver takes as long as it has not kept any of the resumed one.
+// A failed transfer drops the session on either end, and so does one
+// that fits its SYN: its length does not tell the receiver the segment
+// size. The receiver does not linger after FIN in a session: its next
+// rfm69_wtp_rx_start answers the previous transfer's stragglers with
+// FIN|ACK. Give the receiver the longer session timeout of the two.
+//
+// Payloads do not have to sit in RAM. A source (rfm69_wtp_source_set)
+// is read one segment at a time as the window moves, and a sink
+// (rfm69_wtp_sink_set) is written in order as the gaps fill in, e.g.
+// straight to flash. Both only need a buffer of a few segment slots,
+// which also caps the window: the transmitter keeps unacknowledged
+// segments in its slots, the receiver holds out of order ones in its
+// own. Streams have no size limit. The transmitter only learns the end
+// when a read comes up short, and the segment after the last full one
+// then carries FIN, empty if need be.
+//
+// Broadcasts (to WTP_BROADCAST_ADDRESS) are simplex as in the spec: the
+// SYN, every segment after it and the FIN go out once, back to back, with
+// no RTR, and nobody answers. The transmitter is done once the FIN has
+// gone out. A receiver takes a broadcast like any other transfer and ends
+// it at the FIN, or times out on a gap, which stays a gap. Broadcasts
+// never start or resume a session.
+//
+// Where this differs from WTP_specification-1.0.txt:
+//  - Sequence and ack numbers are 32 bits and count segments, and the
+//    SEG flag (0x10) marks packets that carry one.
+//  - RTR asks the receiver for an ACK now, on the last segment of each
+//    burst, new or sent again. The spec has it mark a retransmission and
+//    expects an ACK for every packet, which selective ACKs do away with.
+//  - The receiver does not pick a sequence number of its own. ACKs put
+//    the transmitter's ISN in the seq field, which ties them to the
+//    transfer: data only flows one way, so a receiver sequence would
+//    never move, and the SYN needs no third leg to acknowledge it.
+//  - Teardown has no third leg either. The transmitter is done once the
+//    ACK|FIN for everything comes back and does not answer it with the
+//    spec's final ACK|FIN. A receiver outside a session instead lingers
+//    for two ACK timeouts after FIN and answers a repeated FIN again, in
+//    case its ACK|FIN was lost.
+
+#ifndef RFM69_RP2040_WTP_H
+#define RFM69_RP2040_WTP_H
+
+#include "rfm69_rp2040_interface.h"
+#include "rfm69_rp2040_config.h"
+#include "wtp-1_0.h"
+
+// Largest segment that fits the FIFO in one go (and works with AES)
+#define WTP_SEGMENT_DEFAULT WTP_PKT_DATA_MAX_AES
+
+// SACK bitmap bytes in an ACK. Kept to what fits the FIFO, which makes
+// 432 segments the largest window.
+#define WTP_SACK_SIZE_MAX WTP_PKT_DATA_MAX_AES
+#define WTP_WINDOW_MAX    (WTP_SACK_SIZE_MAX * 8)
+
+// Turnaround on top of the air time of a segment and its ACK, which
+// makes the default ACK timeout
+#ifndef WTP_TIMEOUT_SLACK_MS
+#define WTP_TIMEOUT_SLACK_MS 50
+#endif
+
+// Received/SACKed segments, indexed by segment number modulo the bit
+// count. Has to cover WTP_WINDOW_MAX + 1 segments.
+#define _WTP_MAP_BITS 512
+
+typedef enum _WTP_RETURN {
+	WTP_OK,
+	WTP_TIMEOUT,
+	WTP_BUFFER_OVERFLOW, // RX: payload did not fit the buffer
+	WTP_RESET,           // TX: receiver ended the transfer early
+	WTP_STREAM_ERROR     // The source or sink gave up
+} WTP_RETURN;
+
+typedef enum _WTP_STATE {
+	WTP_STATE_IDLE,
+	WTP_STATE_TX_BURST,    // Segments left to send before the next ACK
+	WTP_STATE_TX_ACK_WAIT,
+	WTP_STATE_RX_LISTEN,   // Waiting for a SYN
+	WTP_STATE_RX_DATA
+} WTP_STATE;
+
+struct wtp_report_s {
+	uint payload_size;
+	uint segment_size;
+	uint bytes_sent;
+	uint bytes_received;
+	uint segments_sent;
+	uint segments_received;
+	uint segments_retransmitted;
+	uint acks_sent;
+	uint acks_received;
+	WTP_RETURN return_status;
+	uint8_t tx_address;
+	uint8_t rx_address;
+};
+
+typedef struct wtp_context_ wtp_context_t;
+
+// Called from rfm69_wtp_poll once a transfer is over, whatever the
+// outcome. The report holds it.
+typedef void (*wtp_callback_t)(wtp_context_t *context, void *arg);
+
+// Fills <dst> with the next <size> bytes of the stream. Returns the bytes
+// read, fewer than <size> at the end of the stream, or < 0 to abort.
+typedef int (*wtp_read_t)(void *arg, uint8_t *dst, uint size);
+
+// Takes the next <size> bytes of the stream. Returns < 0 to abort.
+typedef int (*wtp_write_t)(void *arg, const uint8_t *src, uint size);
+
+struct wtp_context_ {
+	rfm69_context_t *rfm;
+	struct wtp_report_s report;
+	uint8_t *buffer;
+	uint buffer_size;
+	const uint8_t *payload;
+	uint payload_size;
+	uint timeout;         // ms to wait for an ACK, 0 for the default
+	uint rx_timeout;      // ms a receiver waits for a SYN
+	uint8_t retries;      // Tries in a row without progress
+	uint16_t window;      // Segments in flight
+	uint8_t segment_size; // Payload bytes per segment sent
+	wtp_callback_t callback;
+	void *callback_arg;
+	uint session_timeout; // ms a session lives idle, 0 for none
+	wtp_read_t read;
+	void *read_arg;
+	wtp_write_t write;
+	void *write_arg;
+	uint8_t *stream_buffer;
+	uint stream_buffer_size;
+
+	// Session kept between transfers
+	bool session;
+	uint8_t session_peer;
+	uint8_t session_segment;
+	uint32_t session_isn;  // The last transfer's ISN
+	uint32_t session_seq;  // ISN of the next transfer
+	absolute_time_t session_expires;
+
+	// Transfer in progress
+	WTP_STATE state;
+	uint8_t previous_mode;
+	uint8_t peer;
+	absolute_time_t deadline;
+	uint ack_timeout;     // ms, timeout or the default for this transfer
+	uint32_t isn;
+	uint32_t base;        // First segment not acknowledged/received
+	uint32_t segments;    // TX: segments in the payload
+	uint32_t sent;        // TX: segments sent at least once
+	uint32_t cursor;      // TX: next segment of the burst
+	uint32_t last;        // TX: last segment of the burst
+	uint32_t end;         // RX: one past the highest segment received
+	uint32_t fin_index;   // RX: the FIN segment, once fin_seen
+	uint slots;           // Segments the stream buffer holds
+	uint8_t fin_size;     // Size of the (streamed) FIN segment
+	uint retry;
+	bool probe;           // TX: the last ACK wait timed out
+	bool resumed;         // Runs in the session, started without a SYN
+	bool broadcast;       // Sent to WTP_BROADCAST_ADDRESS, never ACKed
+	bool fin_seen;
+	bool fin;             // RX: everything up to the FIN segment is in
+	uint8_t map[_WTP_MAP_BITS / 8];
+};
+
+// Sets up <rfm> for WTP (variable length packets up to RFM69_PACKET_MAX,
+// whitening) and <context> with defaults. Bitrate and frequency are left
+// as they are, set them with a profile or the radio setters.
+bool rfm69_wtp_init(wtp_context_t *context, rfm69_context_t *rfm);
+
+// ACK wait in ms before segments are sent again. The default (0) is
+// worked out per transfer from the bitrate: the air time of a segment
+// and an ACK with a full SACK, plus WTP_TIMEOUT_SLACK_MS.
+bool rfm69_wtp_timeout_set(wtp_context_t *context, uint timeout);
+// SYN wait in ms for receivers (default 30 s)
+bool rfm69_wtp_rx_timeout_set(wtp_context_t *context, uint timeout);
+// Timeouts in a row before a transfer is given up (default 5)
+bool rfm69_wtp_retries_set(wtp_context_t *context, uint8_t retries);
+// Segments in flight past the first unacknowledged one
+// (1 -> WTP_WINDOW_MAX, default 32)
+bool rfm69_wtp_window_set(wtp_context_t *context, uint window);
+
+// Payload bytes per segment we send (1 -> WTP_PKT_DATA_MAX). Segments
+// above WTP_SEGMENT_DEFAULT are streamed through the FIFO, which rules
+// out AES. Only the transmitter sets it, the SYN tells the receiver.
+bool rfm69_wtp_segment_size_set(wtp_context_t *context, uint size);
+
+bool rfm69_wtp_payload_set(wtp_context_t *context, const void *payload, uint payload_size);
+bool rfm69_wtp_rx_buffer_set(wtp_context_t *context, void *buffer, uint buffer_size);
+
+// Sends from <read> instead of the payload while it is not NULL. <buffer>
+// holds buffer_size / segment size segments in flight.
+bool rfm69_wtp_source_set(
+		wtp_context_t *context,
+		wtp_read_t read,
+		void *arg,
+		void *buffer,
+		uint buffer_size);
+
+// Receives into <write> instead of the RX buffer while it is not NULL.
+// <buffer> holds buffer_size / segment size segments that came in out of
+// order, which is also the receive window. The report's payload_size is
+// the stream's size at the end.
+bool rfm69_wtp_sink_set(
+		wtp_context_t *context,
+		wtp_write_t write,
+		void *arg,
+		void *buffer,
+		uint buffer_size);
+
+// Keeps a session with the last peer for <timeout> ms after each
+// successful transfer. 0 turns sessions off (the default). Drops the
+// current session either way.
+bool rfm69_wtp_session_set(wtp_context_t *context, uint timeout);
+// Drops the current session, the next transfer starts with a SYN
+void rfm69_wtp_session_close(wtp_context_t *context);
+
+void rfm69_wtp_callback_set(wtp_context_t *context, wtp_callback_t callback, void *arg);
+
+// Starts sending the payload to <address>, or to everyone if it is
+// WTP_BROADCAST_ADDRESS. False if a transfer is already running on
+// <context>.
+bool rfm69_wtp_tx_start(wtp_context_t *context, uint8_t address);
+
+// Starts waiting up to rx_timeout for a transfer addressed to us or
+// broadcast, to be received into the RX buffer. False if a transfer is
+// already running.
+bool rfm69_wtp_rx_start(wtp_context_t *context);
+
+// Advances the transfer on <context> without waiting on the radio.
+// Returns false once it is over (or none was started), at which point
+// the report holds the outcome and the callback has run. The payload
+// and RX buffer must stay put until then.
+bool rfm69_wtp_poll(wtp_context_t *context);
+
+// Drops the transfer in progress. It ends as WTP_TIMEOUT.
+void rfm69_wtp_abort(wtp_context_t *context);
+
+// Sends the payload to <address>. Blocks until the receiver has
+// acknowledged all of it or the retries run out. A broadcast returns
+// once it has gone out.
+bool rfm69_wtp_transmit(wtp_context_t *context, uint8_t address);
+
+// Waits up to rx_timeout for a transfer addressed to us and receives it
+// into the RX buffer. The report holds the size and the sender.
+bool rfm69_wtp_receive(wtp_context_t *context);
+
+struct wtp_report_s * rfm69_wtp_report_get(wtp_context_t *context);
+
+#endif // RFM69_RP2040_WTP_H
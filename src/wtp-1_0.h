@@ -35,8 +35,8 @@
 // +1 here comes from the fact that the first byte of the header (packet size)
 // is not included included in the packet size. (i.e. packet size byte does not
 // count itself).
-#define WTP_PKT_DATA_MAX (WTP_PKT_SIZE_MAX + 1 - WTP_PKT_HEADER_SIZE)
-#define WTP_PKT_DATA_MAX_AES (WTP_PKT_SIZE_MAX_AES + 1 - WTP_PKT_HEADER_SIZE)
+#define WTP_PKT_DATA_MAX (WTP_PKT_SIZE_MAX + 1 - WTP_HEADER_SIZE)
+#define WTP_PKT_DATA_MAX_AES (WTP_PKT_SIZE_MAX_AES + 1 - WTP_HEADER_SIZE)
 
 // Special broadcast address
 #define WTP_BROADCAST_ADDRESS (0xFF)
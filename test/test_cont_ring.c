@@ -0,0 +1,185 @@
+// test_cont_ring.c
+// Host test of the continuous mode RX ring against a simulated DMA
+
+//	Copyright (C) 2024
+//	Evan Morse
+//	Amelia Vlahogiannis
+
+//	This program is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU General Public License as published by
+//	the Free Software Foundation, either version 3 of the License, or
+//	(at your option) any later version.
+
+//	This program is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU General Public License for more details.
+
+//	You should have received a copy of the GNU General Public License
+//	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rfm69_rp2040_cont_ring.h"
+
+#define RING_BITS 6 // 64 bytes, the smallest ring the tests lap easily
+#define RING_SIZE (1u << RING_BITS)
+#define WORDS     0xFFFFFFFF // What rfm69_cont_rx_start programs
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+// The DMA side of a capture: the ring, and the transfer count it has
+// left, counting down like the hardware one.
+typedef struct {
+	uint8_t ring[RING_SIZE];
+	uint32_t remaining;
+	uint64_t bit; // Next bit of the stream the PIO shifts in
+} sim_t;
+
+static void sim_init(sim_t *sim) {
+	memset(sim->ring, 0, sizeof sim->ring);
+	sim->remaining = WORDS;
+	sim->bit = 0;
+}
+
+static uint64_t sim_head(const sim_t *sim) {
+	return _cont_ring_head(WORDS, sim->remaining);
+}
+
+// Bit <n> of the synthetic stream. Not periodic in the ring size so
+// a wrong offset shows.
+static int stream_bit(uint64_t n) {
+	uint64_t x = n * 0x9E3779B97F4A7C15ull;
+	return (x >> 61) & 1;
+}
+
+// Byte <n> of the stream as the radio sent it, first bit in bit 7
+static uint8_t stream_byte(uint64_t n) {
+	uint8_t b = 0;
+	for (int i = 0; i < 8; i++) b = b << 1 | stream_bit(n * 8 + i);
+	return b;
+}
+
+// One DMA transfer: the PIO autopushes 32 bits shifted in from the
+// right, so the first bit lands in bit 31. The channel swaps bytes and
+// the little endian bus stores the word at the next ring slot.
+static void sim_word(sim_t *sim) {
+	uint32_t word = 0;
+	for (int i = 0; i < 32; i++) word = word << 1 | stream_bit(sim->bit++);
+
+	word = (word >> 24) | ((word >> 8) & 0xFF00) | ((word << 8) & 0xFF0000) | (word << 24);
+
+	uint32_t slot = (uint32_t) (sim_head(sim) & (RING_SIZE - 1));
+	for (int i = 0; i < 4; i++) sim->ring[slot + i] = word >> (8 * i);
+
+	sim->remaining--;
+}
+
+static void sim_words(sim_t *sim, unsigned n) {
+	while (n--) sim_word(sim);
+}
+
+static bool stream_matches(const uint8_t *buf, uint64_t from, size_t len) {
+	for (size_t i = 0; i < len; i++)
+		if (buf[i] != stream_byte(from + i)) return false;
+	return true;
+}
+
+// The ring holds the bytes in the order their bits arrived
+static void test_bit_order(void) {
+	sim_t sim;
+	sim_init(&sim);
+	sim_words(&sim, 4);
+
+	CHECK(sim_head(&sim) == 16);
+	CHECK(stream_matches(sim.ring, 0, 16));
+}
+
+static void test_read_in_pieces(void) {
+	sim_t sim;
+	sim_init(&sim);
+	uint64_t tail = 0;
+	uint32_t overruns = 0;
+	uint8_t buf[RING_SIZE];
+
+	CHECK(_cont_ring_available(sim_head(&sim), tail, RING_BITS) == 0);
+	CHECK(_cont_ring_read(sim.ring, RING_BITS, sim_head(&sim), &tail, &overruns, buf, sizeof buf) == 0);
+
+	// Reads that straddle the end of the ring, over several laps
+	uint64_t read = 0;
+	for (int round = 0; round < 40; round++) {
+		sim_words(&sim, 5);
+		CHECK(_cont_ring_available(sim_head(&sim), tail, RING_BITS) == 20);
+
+		size_t len = _cont_ring_read(sim.ring, RING_BITS, sim_head(&sim), &tail, &overruns, buf, 7);
+		len += _cont_ring_read(sim.ring, RING_BITS, sim_head(&sim), &tail, &overruns, buf + len, sizeof buf - len);
+
+		CHECK(len == 20);
+		CHECK(stream_matches(buf, read, len));
+		read += len;
+	}
+
+	CHECK(tail == read);
+	CHECK(overruns == 0);
+}
+
+// A reader that falls a whole ring behind picks up at the newer half
+static void test_overrun(void) {
+	sim_t sim;
+	sim_init(&sim);
+	uint64_t tail = 0;
+	uint32_t overruns = 0;
+	uint8_t buf[RING_SIZE];
+
+	// Exactly full is not an overrun
+	sim_words(&sim, RING_SIZE / 4);
+	CHECK(_cont_ring_available(sim_head(&sim), tail, RING_BITS) == RING_SIZE);
+	CHECK(_cont_ring_read(sim.ring, RING_BITS, sim_head(&sim), &tail, &overruns, buf, 4) == 4);
+	CHECK(overruns == 0);
+	CHECK(stream_matches(buf, 0, 4));
+
+	sim_words(&sim, RING_SIZE / 4 + 3);
+	uint64_t head = sim_head(&sim);
+	CHECK(_cont_ring_available(head, tail, RING_BITS) == RING_SIZE);
+
+	size_t len = _cont_ring_read(sim.ring, RING_BITS, head, &tail, &overruns, buf, sizeof buf);
+	CHECK(overruns == 1);
+	CHECK(len == RING_SIZE / 2);
+	CHECK(stream_matches(buf, head - RING_SIZE / 2, len));
+	CHECK(tail == head);
+}
+
+// Byte counts carry on past 4 GiB, where a 32 bit count would wrap
+static void test_head_past_32_bits(void) {
+	CHECK(_cont_ring_head(WORDS, WORDS) == 0);
+	CHECK(_cont_ring_head(WORDS, 0) == 0x3FFFFFFFCull);
+
+	uint64_t head = _cont_ring_head(WORDS, WORDS - 0x40000001u);
+	uint64_t tail = head - 8;
+	CHECK(head > 0xFFFFFFFFull);
+	CHECK(_cont_ring_available(head, tail, RING_BITS) == 8);
+}
+
+int main(void) {
+	test_bit_order();
+	test_read_in_pieces();
+	test_overrun();
+	test_head_past_32_bits();
+
+	if (failures) {
+		printf("%d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("cont ring: ok\n");
+	return EXIT_SUCCESS;
+}